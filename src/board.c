@@ -22,6 +22,7 @@
 #include <stddef.h>
 #include "config.h"
 #include "gtksudoku.h"
+#include "board.h"
 
 int
 isboardchar(int c)
@@ -59,3 +60,126 @@ val2boardchar(int val)
       return '1' + d;
   return '.';
 }
+
+/* Number of digits in a set of digits. */
+
+static int
+ndigits(int val)
+{
+  int n;
+  for (n = 0; val; val &= val - 1)
+    n++;
+  return n;
+}
+
+static int
+read_line(const char *s, int vals[NCELLS], int determined[NCELLS])
+{
+  int rows[DIGITS] = { 0 }, cols[DIGITS] = { 0 }, squares[DIGITS] = { 0 };
+  int i = 0;
+  for (; *s; s++) {
+    if (!isboardchar(*s))
+      continue;
+    if (i >= NCELLS)
+      return 0;
+    int row = i / DIGITS, col = i % DIGITS;
+    int square = SIDES * (row / SIDES) + col / SIDES;
+    int used = rows[row] | cols[col] | squares[square];
+    vals[i] = 0;
+    determined[i] = 0;
+    if (*s != '.') {		/* A clue */
+      int val = boardchar2val(*s);
+      if (!(val & used)) {
+	vals[i] = val;
+	determined[i] = 1;
+	rows[row] |= val;
+	cols[col] |= val;
+	squares[square] |= val;
+      }
+    }
+    else
+      vals[i] = ALL;
+    i++;
+  }
+  if (i != NCELLS)
+    return 0;
+  for (i = 0; i < NCELLS; i++)	/* Eliminate the clues */
+    if (vals[i] == ALL) {
+      int row = i / DIGITS, col = i % DIGITS;
+      int square = SIDES * (row / SIDES) + col / SIDES;
+      vals[i] &= ~(rows[row] | cols[col] | squares[square]);
+    }
+  return 1;
+}
+
+static int
+read_candidates(const char *s, int vals[NCELLS], int determined[NCELLS])
+{
+  int i = 0;
+  while (*s) {
+    if (*s < '0' || *s > '9') {
+      s++;
+      continue;
+    }
+    if (i >= NCELLS)
+      return 0;
+    int val = 0;
+    for (; *s >= '0' && *s <= '9'; s++)
+      if (*s != '0')
+	val |= boardchar2val(*s);
+    vals[i] = val;
+    determined[i] = ndigits(val) == 1;
+    i++;
+  }
+  return i == NCELLS;
+}
+
+int
+board_read(const char *s, int vals[NCELLS], int determined[NCELLS])
+{
+  if (read_line(s, vals, determined))
+    return BOARD_LINE;
+  else if (read_candidates(s, vals, determined))
+    return BOARD_CANDIDATES;
+  else
+    return -1;
+}
+
+size_t
+board_write(char *buf, int form,
+	    const int vals[NCELLS], const int determined[NCELLS])
+{
+  char *b = buf;
+  int width[DIGITS];
+  int i, d;
+  if (form == BOARD_CANDIDATES)	/* Find the width of each column */
+    for (i = 0; i < NCELLS; i++) {
+      int n = ndigits(vals[i]);
+      if (i < DIGITS || width[i % DIGITS] < n)
+	width[i % DIGITS] = n ? n : 1;
+    }
+  for (i = 0; i < NCELLS; i++) {
+    int col = i % DIGITS;
+    if (form != BOARD_CANDIDATES)
+      *b++ = determined[i] ? val2boardchar(vals[i]) : '.';
+    else {
+      int n = 0;
+      for (d = 0; d < DIGITS; d++)
+	if (vals[i] & 1 << d) {
+	  *b++ = '1' + d;
+	  n++;
+	}
+      if (!n) {			/* No candidates */
+	*b++ = '0';
+	n = 1;
+      }
+      if (col < DIGITS - 1)
+	for (; n <= width[col]; n++)
+	  *b++ = ' ';
+    }
+    if (form != BOARD_LINE && col == DIGITS - 1)
+      *b++ = '\n';
+  }
+  *b = 0;
+  return b - buf;
+}
@@ -15,4 +15,42 @@ int boardchar2val(int c);
 /* Converts a set of digits to a cell descriptor. */
 int val2boardchar(int val);
 
+/* Number of cells in a board. */
+#define NCELLS (DIGITS * DIGITS)
+
+/* Forms of a board as a string.  In the line and grid forms, each
+   cell is a valid cell descriptor, and a digit is given only for a
+   determined cell.  The grid form puts each row on a line of its
+   own.  In the candidate form, each cell is the sequence of digits
+   still possible for it, or 0 when none are, and each row is on a
+   line of its own. */
+#define BOARD_LINE 0
+#define BOARD_GRID 1
+#define BOARD_CANDIDATES 2
+
+/* The extension of a file that holds a board in candidate form. */
+#define BOARD_CANDIDATES_EXT ".gsd"
+
+/* Room for a board written in any form, including the final null. */
+#define BOARD_SIZE (NCELLS * (DIGITS + 1) + 1)
+
+/* Reads a board in string s.  A string with NCELLS valid cell
+   descriptors is read in line form, which includes the grid form, as
+   characters other than descriptors are ignored.  A descriptor gives
+   the value of a determined cell, and the digit is eliminated from
+   the other cells in its row, column, and square.  A clue that
+   repeats a digit already given in one of those places leaves its
+   cell with no possible values.  Otherwise, a string with NCELLS
+   sequences of digits is read in candidate form, and a cell with a
+   single candidate is determined.  Sets of digits and determined
+   flags are stored in vals and determined.  Returns BOARD_LINE for a
+   board read in line or grid form, BOARD_CANDIDATES for one read in
+   candidate form, or -1 when s is neither. */
+int board_read(const char *s, int vals[NCELLS], int determined[NCELLS]);
+
+/* Writes a board in the given form into buf, which must have room
+   for BOARD_SIZE characters.  Returns the length of the string. */
+size_t board_write(char *buf, int form,
+		   const int vals[NCELLS], const int determined[NCELLS]);
+
 #endif
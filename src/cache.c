@@ -0,0 +1,290 @@
+/*
+ * A cache of solved puzzles kept in a file.
+ *
+ * Copyright (C) 2006 John D. Ramsdell
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/*
+ * The cache is a hash table with open addressing and a fixed number
+ * of slots, so it never grows.  A puzzle is looked for in a few slots
+ * starting at the one given by the hash of its clues, and when all of
+ * them are taken, storing the puzzle evicts the one in the first
+ * slot.  Where mmap is available, the file is mapped and shared, so
+ * a store is written back by the system, and a new file is sparse,
+ * taking disk space only for the slots in use.  Otherwise, the file
+ * is read when opened and written when closed.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "gtksudoku.h"
+#include "board.h"
+#include "cache.h"
+
+#if defined HAVE_SYS_MMAN_H && defined HAVE_MMAP
+#define USE_MMAP 1
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/* Clues are stored a digit to four bits, with zero for a blank. */
+#define NIBBLES ((NCELLS + 1) / 2)
+
+/* A cell of the board solved is its set of digits, with this bit set
+   when it is determined. */
+#define DETERMINED 0x8000
+
+typedef struct {
+  uint64_t hash;		/* Zero when the slot is empty */
+  uint16_t steps;
+  uint8_t difficulty;
+  uint8_t clues[NIBBLES];
+  uint16_t solution[NCELLS];
+} slot;
+
+typedef struct {
+  char magic[4];
+  uint32_t order;		/* Detects a change of byte order */
+  uint32_t slots;
+  uint32_t reserved;
+} header;
+
+/* Change the magic number when the rules change, as the solutions
+   cached for the old rules are then stale. */
+static const char magic[] = {'G', 'S', 'H', 'A'};
+#define ORDER 0x01020304
+
+#define SLOTS (1 << 16)		/* A power of two */
+#define PROBES 8
+#define CACHE_SIZE (sizeof(header) + SLOTS * sizeof(slot))
+
+static header *cache;		/* The cache when open */
+static slot *table;
+
+#if !defined USE_MMAP
+static char *cache_name;	/* Where to write the cache */
+#endif
+
+/* Is the cache in buf of size n bytes usable? */
+
+static int
+valid(const header *h, size_t n)
+{
+  return n == CACHE_SIZE
+    && !memcmp(h->magic, magic, sizeof magic)
+    && h->order == ORDER
+    && h->slots == SLOTS;
+}
+
+static void
+init_header(header *h)
+{
+  memcpy(h->magic, magic, sizeof magic);
+  h->order = ORDER;
+  h->slots = SLOTS;
+}
+
+/* Empty the cache. */
+
+static void
+init(header *h)
+{
+  memset(h, 0, CACHE_SIZE);
+  init_header(h);
+}
+
+#if defined USE_MMAP
+
+const char *
+cache_open(const char *file_name)
+{
+  cache_close();
+  int fd = open(file_name, O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+    return "failed to open cache";
+  struct stat st;
+  if (fstat(fd, &st)) {
+    close(fd);
+    return "failed to open cache";
+  }
+  int fresh = st.st_size != CACHE_SIZE; /* Start over with zeros */
+  if (fresh && (ftruncate(fd, 0) || ftruncate(fd, CACHE_SIZE))) {
+    close(fd);
+    return "failed to size cache";
+  }
+  void *p = mmap(NULL, CACHE_SIZE, PROT_READ | PROT_WRITE,
+		 MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return "failed to map cache";
+  cache = p;
+  if (fresh)
+    init_header(cache);
+  else if (!valid(cache, CACHE_SIZE))
+    init(cache);
+  table = (slot *)(cache + 1);
+  return NULL;
+}
+
+void
+cache_close(void)
+{
+  if (cache)
+    munmap(cache, CACHE_SIZE);
+  cache = NULL;
+  table = NULL;
+}
+
+#else
+
+const char *
+cache_open(const char *file_name)
+{
+  cache_close();
+  cache = malloc(CACHE_SIZE);
+  cache_name = malloc(strlen(file_name) + 1);
+  if (!cache || !cache_name) {
+    cache_close();
+    return "failed to allocate cache";
+  }
+  strcpy(cache_name, file_name);
+  FILE *in = fopen(file_name, "rb");
+  size_t n = 0;
+  if (in) {
+    n = fread(cache, 1, CACHE_SIZE, in);
+    fclose(in);
+  }
+  if (!valid(cache, n))
+    init(cache);
+  table = (slot *)(cache + 1);
+  return NULL;
+}
+
+void
+cache_close(void)
+{
+  if (cache && cache_name) {
+    FILE *out = fopen(cache_name, "wb");
+    if (out) {
+      fwrite(cache, 1, CACHE_SIZE, out);
+      fclose(out);
+    }
+  }
+  free(cache);
+  free(cache_name);
+  cache = NULL;
+  table = NULL;
+  cache_name = NULL;
+}
+
+#endif
+
+/* The FNV-1a hash of a board, never zero. */
+
+static uint64_t
+hash(const char clues[])
+{
+  uint64_t h = UINT64_C(14695981039346656037);
+  int i;
+  for (i = 0; i < NCELLS; i++) {
+    h ^= (unsigned char)clues[i];
+    h *= UINT64_C(1099511628211);
+  }
+  return h ? h : 1;
+}
+
+static void
+pack(uint8_t nibbles[], const char cells[])
+{
+  memset(nibbles, 0, NIBBLES);
+  int i;
+  for (i = 0; i < NCELLS; i++) {
+    int d = cells[i] >= '1' && cells[i] <= '9' ? cells[i] - '0' : 0;
+    nibbles[i / 2] |= d << (i % 2 * 4);
+  }
+}
+
+/* Find the slot holding a puzzle, or NULL when it is missing. */
+
+static slot *
+find(uint64_t h, const uint8_t key[])
+{
+  int k;
+  for (k = 0; k < PROBES; k++) {
+    slot *s = &table[(h + k) & (SLOTS - 1)];
+    if (!s->hash)
+      return NULL;
+    if (s->hash == h && !memcmp(s->clues, key, NIBBLES))
+      return s;
+  }
+  return NULL;
+}
+
+int
+cache_lookup(const char clues[], int vals[], int determined[],
+	     int *difficulty, int *steps)
+{
+  if (!cache)
+    return 0;
+  uint8_t key[NIBBLES];
+  pack(key, clues);
+  slot *s = find(hash(clues), key);
+  if (!s)
+    return 0;
+  int i;
+  for (i = 0; i < NCELLS; i++) {
+    vals[i] = s->solution[i] & ALL;
+    determined[i] = (s->solution[i] & DETERMINED) != 0;
+  }
+  *difficulty = s->difficulty;
+  *steps = s->steps;
+  return 1;
+}
+
+void
+cache_store(const char clues[], const int vals[], const int determined[],
+	    int difficulty, int steps)
+{
+  if (!cache)
+    return;
+  uint8_t key[NIBBLES];
+  pack(key, clues);
+  uint64_t h = hash(clues);
+  slot *s = find(h, key);
+  int k;
+  for (k = 0; !s && k < PROBES; k++) {
+    slot *t = &table[(h + k) & (SLOTS - 1)];
+    if (!t->hash)
+      s = t;
+  }
+  if (!s)			/* Evict */
+    s = &table[h & (SLOTS - 1)];
+  s->hash = h;
+  s->steps = steps > UINT16_MAX ? UINT16_MAX : steps;
+  s->difficulty = difficulty;
+  memcpy(s->clues, key, NIBBLES);
+  for (k = 0; k < NCELLS; k++)
+    s->solution[k] = (vals[k] & ALL) | (determined[k] ? DETERMINED : 0);
+}
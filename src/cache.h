@@ -0,0 +1,29 @@
+/* A cache of solved puzzles kept in a file. */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+/* The name of the cache file within the cache directory. */
+#define CACHE_FILE "solved"
+
+/* Opens the cache in the named file, creating it if need be.
+   Returns a non-NULL message on error, in which case lookups miss
+   and stores are ignored. */
+const char *cache_open(const char *file_name);
+
+/* Closes the cache, if open. */
+void cache_close(void);
+
+/* Looks up the puzzle whose clues are given as NCELLS cell
+   descriptors.  On a hit, returns non-zero, sets the NCELLS sets of
+   digits and determined flags of the board as solved, and sets the
+   difficulty and steps recorded with it. */
+int cache_lookup(const char clues[], int vals[], int determined[],
+		 int *difficulty, int *steps);
+
+/* Records the board as solved from the puzzle with the given clues,
+   evicting another puzzle when its place in the cache is full. */
+void cache_store(const char clues[], const int vals[],
+		 const int determined[], int difficulty, int steps);
+
+#endif
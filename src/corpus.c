@@ -0,0 +1,208 @@
+/*
+ * Packed files of puzzles.
+ *
+ * Copyright (C) 2006 John D. Ramsdell
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/*
+ * A puzzle with c clues takes 11 bytes for its bitmap and about
+ * 1.25 c bytes for its digits, so a typical puzzle of 25 clues packs
+ * into 22 bytes rather than the 82 of a line of text.  Puzzles vary
+ * in size, so finding one means reading the offset of its block and
+ * skipping the puzzles before it in the block, each of whose size is
+ * given by its bitmap.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "config.h"
+#include "gtksudoku.h"
+#include "board.h"
+#include "corpus.h"
+
+static const unsigned char magic[] = {'G', 'S', 'C'};
+#define FORMAT 1		/* Version of the format */
+#define HEADER 12
+
+/* Bytes in the bitmap of the cells with clues. */
+#define MAP_SIZE ((NCELLS + 7) / 8)
+
+/* Three base 9 digits fit in ten bits. */
+#define GROUP_DIGITS 3
+#define GROUP_BITS 10
+
+/* Bytes used by the digits of c clues. */
+static size_t
+digits_size(int c)
+{
+  int groups = (c + GROUP_DIGITS - 1) / GROUP_DIGITS;
+  return (groups * GROUP_BITS + 7) / 8;
+}
+
+size_t
+corpus_pack(unsigned char *buf, const char *s, size_t len)
+{
+  int digits[NCELLS];
+  int i = 0, c = 0;
+  memset(buf, 0, MAP_SIZE);
+  for (; len > 0 && i < NCELLS; s++, len--)
+    if (isboardchar(*s)) {
+      if (*s != '.') {
+	buf[i / 8] |= 1 << i % 8;
+	digits[c++] = *s - '1';
+      }
+      i++;
+    }
+  if (i < NCELLS)
+    return 0;
+
+  unsigned char *p = buf + MAP_SIZE;
+  unsigned long acc = 0;	/* Bits not yet written */
+  int nbits = 0;
+  for (i = 0; i < c; i += GROUP_DIGITS) {
+    int group = 0, k;
+    for (k = GROUP_DIGITS - 1; k >= 0; k--)
+      group = group * 9 + (i + k < c ? digits[i + k] : 0);
+    acc |= (unsigned long)group << nbits;
+    for (nbits += GROUP_BITS; nbits >= 8; nbits -= 8) {
+      *p++ = acc;
+      acc >>= 8;
+    }
+  }
+  if (nbits > 0)
+    *p++ = acc;
+  return p - buf;
+}
+
+/* The number of clues in a puzzle. */
+
+static int
+clues(const unsigned char *buf)
+{
+  int i, c = 0;
+  for (i = 0; i < MAP_SIZE; i++) {
+    unsigned int b = buf[i];
+    for (; b; b &= b - 1)
+      c++;
+  }
+  return c;
+}
+
+static void
+unpack(const unsigned char *buf, char line[])
+{
+  int c = clues(buf);
+  const unsigned char *p = buf + MAP_SIZE;
+  unsigned long acc = 0;	/* Bits read but not yet used */
+  int nbits = 0;
+  int group = 0, left = 0;	/* Digits left in group */
+  int i;
+  for (i = 0; i < NCELLS; i++) {
+    if (!(buf[i / 8] >> i % 8 & 1)) {
+      line[i] = '.';
+      continue;
+    }
+    if (!left) {
+      for (; nbits < GROUP_BITS; nbits += 8)
+	acc |= (unsigned long)*p++ << nbits;
+      group = acc & ((1 << GROUP_BITS) - 1);
+      acc >>= GROUP_BITS;
+      nbits -= GROUP_BITS;
+      left = c < GROUP_DIGITS ? c : GROUP_DIGITS;
+      c -= left;
+    }
+    line[i] = '1' + group % 9;
+    group /= 9;
+    left--;
+  }
+}
+
+static void
+put32(unsigned char *p, unsigned long x)
+{
+  p[0] = x >> 24;
+  p[1] = x >> 16;
+  p[2] = x >> 8;
+  p[3] = x;
+}
+
+static unsigned long
+get32(const unsigned char *p)
+{
+  return (unsigned long)p[0] << 24 | (unsigned long)p[1] << 16
+    | (unsigned long)p[2] << 8 | p[3];
+}
+
+static int
+blocks(int n)
+{
+  return (n + CORPUS_BLOCK - 1) / CORPUS_BLOCK;
+}
+
+size_t
+corpus_header_size(int n)
+{
+  return HEADER + 4 * (size_t)blocks(n);
+}
+
+void
+corpus_put_header(unsigned char *buf, int n, const unsigned long offsets[])
+{
+  memcpy(buf, magic, sizeof magic);
+  buf[3] = FORMAT;
+  put32(buf + 4, n);
+  put32(buf + 8, CORPUS_BLOCK);
+  int i;
+  for (i = 0; i < blocks(n); i++)
+    put32(buf + HEADER + 4 * i, offsets[i]);
+}
+
+const char *
+corpus_open(const unsigned char *buf, size_t n, int *count)
+{
+  if (n < HEADER || memcmp(buf, magic, sizeof magic))
+    return "not a corpus";
+  if (buf[3] != FORMAT || get32(buf + 8) != CORPUS_BLOCK)
+    return "unsupported corpus version";
+  unsigned long k = get32(buf + 4);
+  if (k > (n - HEADER) / 4 * CORPUS_BLOCK || n < corpus_header_size(k))
+    return "corpus is truncated";
+  *count = k;
+  return NULL;
+}
+
+int
+corpus_get(const unsigned char *buf, size_t n, int k, char line[])
+{
+  if (k < 0 || (unsigned long)k >= get32(buf + 4))
+    return 0;
+  size_t at = get32(buf + HEADER + 4 * (k / CORPUS_BLOCK));
+  int i;
+  for (i = k / CORPUS_BLOCK * CORPUS_BLOCK;; i++) {
+    if (at + MAP_SIZE > n)
+      return 0;
+    size_t size = MAP_SIZE + digits_size(clues(buf + at));
+    if (at + size > n)
+      return 0;
+    if (i == k) {
+      unpack(buf + at, line);
+      return 1;
+    }
+    at += size;
+  }
+}
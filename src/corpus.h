@@ -0,0 +1,52 @@
+/* Packed files of puzzles. */
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <stddef.h>
+
+/* The extension of a file that holds a packed corpus. */
+#define CORPUS_EXT ".gsc"
+
+/* A corpus starts with a header giving the format version, the
+   number of puzzles, and the number of puzzles in a block, followed
+   by the offset of each block from the start of the file.  The
+   puzzles follow.  A puzzle is a bitmap of the cells with clues,
+   followed by the clue digits in base 9, three digits to ten bits.
+   Multibyte numbers are big endian. */
+
+/* Puzzles in a block. */
+#define CORPUS_BLOCK 64
+
+/* Offsets are 32 bits, so the puzzles of a corpus must stop before
+   their bytes pass this size, which leaves room for the header. */
+#define CORPUS_MAX_PACKED 0xf0000000UL
+
+/* Most bytes used by a puzzle. */
+#define CORPUS_PUZZLE_MAX ((NCELLS + 7) / 8 + (NCELLS / 3 * 10 + 7) / 8)
+
+/* Packs the board given by the first NCELLS valid cell descriptors in
+   the len characters of s into buf, which has room for
+   CORPUS_PUZZLE_MAX bytes.  Returns the number of bytes written, or 0
+   when s holds fewer than NCELLS descriptors. */
+size_t corpus_pack(unsigned char *buf, const char *s, size_t len);
+
+/* Returns the size in bytes of the header of a corpus of n puzzles. */
+size_t corpus_header_size(int n);
+
+/* Writes the header of a corpus of n puzzles into buf.  Element i of
+   offsets is the offset of block i from the start of the file. */
+void corpus_put_header(unsigned char *buf, int n,
+		       const unsigned long offsets[]);
+
+/* Checks the header of the corpus in buf of size n bytes.  Sets the
+   number of puzzles on success.  Returns a non-NULL message on
+   error. */
+const char *corpus_open(const unsigned char *buf, size_t n, int *count);
+
+/* Writes puzzle k, counting from zero, of a corpus checked by
+   corpus_open into line as NCELLS cell descriptors.  Returns zero
+   when the puzzle is not in the corpus. */
+int corpus_get(const unsigned char *buf, size_t n, int k, char line[]);
+
+#endif
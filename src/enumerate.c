@@ -0,0 +1,294 @@
+/*
+ * Writing the solutions of a board to a file.
+ *
+ * Copyright (C) 2006 John D. Ramsdell
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/*
+ * The search runs in threads of its own, so that the program stays
+ * responsive while it runs, and can ask it to stop.  The search is
+ * split into parts at the first cells that branch, and the threads
+ * take parts in turn until none are left.  A thread collects
+ * solutions in a batch of its own, and writes the batch to the file
+ * while holding the lock, so solutions stream to the file and the
+ * lock is taken once a batch.  The limit is enforced when a batch is
+ * written, and a thread stops searching once it is reached.
+ *
+ * A corpus begins with a header whose size depends on the number of
+ * puzzles, which is not known until the end.  The packed solutions
+ * are written to a temporary file, and copied after the header once
+ * the search is over, by the last thread to finish.  A corpus can
+ * hold only so many bytes, so the search stops when it is full, and
+ * the corpus gets the solutions written so far.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "config.h"
+#include "gtksudoku.h"
+#include "board.h"
+#include "corpus.h"
+#include "solver.h"
+#include "enumerate.h"
+
+/* Parts of the search for each thread, so that a thread that finishes
+   early can take another. */
+#define PARTS_PER_THREAD 16
+
+/* Solutions collected by a thread before writing them. */
+#define BATCH 256
+
+struct enumeration {
+  GMutex lock;
+  GThread **threads;
+  int nthreads;
+  gint running;			/* Threads still searching */
+  gint done;			/* Is the file finished? */
+  GTimer *timer;
+  double seconds;		/* Time taken to finish the file */
+  FILE *file;			/* The file named by the user */
+  int (*parts)[NCELLS];
+  int nparts;
+  int next;			/* The next part to search */
+  FILE *out;
+  int packed;
+  long limit;
+  int truncated;		/* Stopped because the corpus is full */
+  long written;
+  unsigned long used;		/* Bytes of packed solutions */
+  unsigned long *offsets;	/* Offset of each block */
+  long blocks;			/* Room in offsets */
+  const char *error;
+  gint stop;
+};
+
+typedef struct {
+  enumeration *j;
+  int n;
+  char lines[BATCH][NCELLS];
+} batch;
+
+/* Write a solution.  Called with the lock held, and only while there
+   is room for it. */
+
+static void
+write_solution(enumeration *j, const char line[NCELLS])
+{
+  if (!j->packed) {
+    if (fwrite(line, 1, NCELLS, j->out) != NCELLS
+	|| putc('\n', j->out) == EOF)
+      j->error = "failed to write file";
+    return;
+  }
+  long block = j->written / CORPUS_BLOCK;
+  if (block >= j->blocks) {
+    j->blocks = 2 * block + 1;
+    j->offsets = g_renew(unsigned long, j->offsets, j->blocks);
+  }
+  if (j->written % CORPUS_BLOCK == 0)
+    j->offsets[block] = j->used;
+  unsigned char buf[CORPUS_PUZZLE_MAX];
+  size_t m = corpus_pack(buf, line, NCELLS);
+  if (fwrite(buf, 1, m, j->out) != m)
+    j->error = "failed to write file";
+  j->used += m;
+}
+
+/* Write the solutions in a batch, up to the limit.  Returns non-zero
+   when the search should stop. */
+
+static int
+flush(batch *b)
+{
+  enumeration *j = b->j;
+  int k;
+  g_mutex_lock(&j->lock);
+  for (k = 0; k < b->n && !j->error; k++) {
+    if (j->limit && j->written >= j->limit)
+      break;
+    if (j->packed
+	&& (j->used > CORPUS_MAX_PACKED || j->written >= G_MAXINT)) {
+      j->truncated = 1;
+      break;
+    }
+    write_solution(j, b->lines[k]);
+    if (!j->error)
+      j->written++;
+  }
+  if (j->error || j->truncated || (j->limit && j->written >= j->limit))
+    g_atomic_int_set(&j->stop, 1);
+  g_mutex_unlock(&j->lock);
+  b->n = 0;
+  return g_atomic_int_get(&j->stop);
+}
+
+static int
+emit(const char line[NCELLS], void *data)
+{
+  batch *b = data;
+  if (g_atomic_int_get(&b->j->stop))
+    return 1;
+  memcpy(b->lines[b->n++], line, NCELLS);
+  return b->n == BATCH && flush(b);
+}
+
+/* Write the header of the corpus of packed solutions, and copy the
+   solutions after it. */
+
+static const char *
+write_corpus(enumeration *j, FILE *out)
+{
+  int n = j->written;
+  size_t header = corpus_header_size(n);
+  unsigned char *head = g_malloc(header);
+  int i;
+  for (i = 0; i < (n + CORPUS_BLOCK - 1) / CORPUS_BLOCK; i++)
+    j->offsets[i] += header;
+  corpus_put_header(head, n, j->offsets);
+  int ok = fwrite(head, 1, header, out) == header;
+  g_free(head);
+  char buf[BUFSIZ];
+  size_t m;
+  rewind(j->out);
+  while (ok && (m = fread(buf, 1, sizeof buf, j->out)) > 0)
+    ok = fwrite(buf, 1, m, out) == m;
+  return ok && !ferror(j->out) ? NULL : "failed to write file";
+}
+
+/* Finish the file once the search is over, and tell the program it
+   is done. */
+
+static void
+finish_file(enumeration *j)
+{
+  if (j->packed && !j->error)
+    j->error = write_corpus(j, j->file);
+  if (j->packed)
+    fclose(j->out);
+  if (fclose(j->file) && !j->error)
+    j->error = "failed to write file";
+  j->seconds = g_timer_elapsed(j->timer, NULL);
+  g_atomic_int_set(&j->done, 1);
+}
+
+static gpointer
+worker(gpointer data)
+{
+  enumeration *j = data;
+  batch *b = g_new(batch, 1);
+  b->j = j;
+  b->n = 0;
+  for (;;) {
+    g_mutex_lock(&j->lock);
+    int k = j->next++;
+    g_mutex_unlock(&j->lock);
+    if (k >= j->nparts || solver_enumerate(j->parts[k], emit, b))
+      break;
+  }
+  if (b->n)
+    flush(b);
+  g_free(b);
+  if (g_atomic_int_dec_and_test(&j->running))
+    finish_file(j);
+  return NULL;
+}
+
+const char *
+enumerate_start(const int vals[NCELLS], const char *file_name,
+		long limit, enumeration **e)
+{
+  *e = NULL;
+  int packed = g_str_has_suffix(file_name, CORPUS_EXT);
+  FILE *file = g_fopen(file_name, packed ? "wb" : "w");
+  if (!file)
+    return "failed to open file";
+  enumeration *j = g_new0(enumeration, 1);
+  j->file = file;
+  j->packed = packed;
+  j->limit = limit;
+  j->out = j->packed ? tmpfile() : file;
+  if (!j->out) {
+    fclose(file);
+    g_free(j);
+    return "failed to open temporary file";
+  }
+  j->nthreads = g_get_num_processors();
+  j->parts = g_malloc(j->nthreads * PARTS_PER_THREAD * sizeof *j->parts);
+  j->nparts = solver_split(vals, j->nthreads * PARTS_PER_THREAD, j->parts);
+  if (j->nparts < 0) {
+    if (j->packed)
+      fclose(j->out);
+    fclose(file);
+    g_free(j->parts);
+    g_free(j);
+    return "out of memory";
+  }
+  g_mutex_init(&j->lock);
+  j->timer = g_timer_new();
+  j->running = j->nthreads;
+  j->threads = g_new(GThread *, j->nthreads);
+  int k;
+  for (k = 0; k < j->nthreads; k++)
+    j->threads[k] = g_thread_new("enumerate", worker, j);
+  *e = j;
+  return NULL;
+}
+
+void
+enumerate_progress(enumeration *e, long *count, double *seconds)
+{
+  g_mutex_lock(&e->lock);
+  *count = e->written;
+  g_mutex_unlock(&e->lock);
+  *seconds = g_timer_elapsed(e->timer, NULL);
+}
+
+int
+enumerate_done(enumeration *e)
+{
+  return g_atomic_int_get(&e->done);
+}
+
+void
+enumerate_cancel(enumeration *e)
+{
+  g_atomic_int_set(&e->stop, 1);
+}
+
+const char *
+enumerate_finish(enumeration *e, long *count, double *seconds,
+		 int *truncated)
+{
+  int k;
+  for (k = 0; k < e->nthreads; k++)
+    g_thread_join(e->threads[k]);
+  *count = e->written;
+  *seconds = e->seconds;
+  *truncated = e->truncated;
+  const char *error = e->error;
+  g_free(e->threads);
+  g_mutex_clear(&e->lock);
+  g_timer_destroy(e->timer);
+  g_free(e->parts);
+  g_free(e->offsets);
+  g_free(e);
+  return error;
+}
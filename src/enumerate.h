@@ -0,0 +1,39 @@
+/* Writing the solutions of a board to a file. */
+
+#ifndef ENUMERATE_H
+#define ENUMERATE_H
+
+/* A search for the solutions of a board, running in the background. */
+typedef struct enumeration enumeration;
+
+/* Starts writing the solutions of the board whose cells have the sets
+   of digits in vals to the named file, stopping after limit solutions
+   unless limit is zero.  A file with the corpus extension gets a
+   packed corpus, and any other file a solution to a line.  The search
+   is shared among a thread for each processor, so the order of the
+   solutions varies.  Sets e to the search, which must be passed to
+   enumerate_finish once it is done.  Returns a non-NULL message on
+   error, in which case no search is started. */
+const char *enumerate_start(const int vals[NCELLS], const char *file_name,
+			    long limit, enumeration **e);
+
+/* Sets count to the number of solutions written so far, and seconds
+   to the time since the search started. */
+void enumerate_progress(enumeration *e, long *count, double *seconds);
+
+/* Returns non-zero once the search is over and the file is written. */
+int enumerate_done(enumeration *e);
+
+/* Asks the search to stop.  The file keeps the solutions written so
+   far. */
+void enumerate_cancel(enumeration *e);
+
+/* Waits for the search to be done, and frees it.  Sets count to the
+   number of solutions written and seconds to the time taken.  When a
+   corpus fills up before the limit is reached, it keeps the solutions
+   that fit, and truncated is set to non-zero.  Returns a non-NULL
+   message on error. */
+const char *enumerate_finish(enumeration *e, long *count, double *seconds,
+			     int *truncated);
+
+#endif
@@ -36,6 +36,11 @@
 #include "sudokuedit.h"
 #include "showtext.h"
 #include "board.h"
+#include "cache.h"
+#include "snapshot.h"
+#include "corpus.h"
+#include "puzzles.h"
+#include "enumerate.h"
 #include "interp.h"
 #include "grid.h"
 
@@ -67,8 +72,9 @@ g_type_register_static_simple (GType             parent_type,
 }
 #endif
 
-/* Size of the buffer used to read a board from a text file. */
-#define NBOARD (DIGITS * DIGITS * DIGITS)
+/* Size of the buffer used to read a board from a text file, with
+   room for separators around the cells of a candidate grid. */
+#define NBOARD (2 * BOARD_SIZE)
 
 /* Functions provided to the command interpreter. */
 
@@ -116,11 +122,65 @@ set_status(char *malloced_message)
     gtk_entry_set_text(status, "");
 }
 
-/* Load a board from a file. */
+/* Collect garbage while the program is idle. */
+
+static guint collector;		/* Idle source or zero */
+
+static gboolean
+collect_garbage(gpointer data)
+{
+  interp_collect();
+  collector = 0;
+  return FALSE;
+}
+
+static void
+schedule_collection(void)
+{
+  if (!collector)
+    collector = g_idle_add(collect_garbage, NULL);
+}
+
+/* Load a board and its history from a snapshot file. */
+
+static void
+load_snapshot(const char *file_name)
+{
+  gchar *data;
+  gsize n;
+  if (!g_file_get_contents(file_name, &data, &n, NULL)) {
+    gtk_entry_set_text(status, "failed to read file");
+    return;
+  }
+  puzzles_close();
+  set_status(interp_load_snapshot(data, n));
+  g_free(data);
+  schedule_collection();
+}
+
+/* Load a board from a file.  A file with the snapshot extension holds
+   a snapshot.  A file with a board on its first line holds a puzzle
+   on each line, and the first puzzle is loaded.  Any other file holds
+   one board as text. */
 
 static void
 load_file(const char *file_name)
 {
+  if (g_str_has_suffix(file_name, SNAPSHOT_EXT)) {
+    load_snapshot(file_name);
+    return;
+  }
+  const char *msg = puzzles_open(file_name);
+  if (!msg) {			/* A file of puzzles */
+    set_status(interp_eval("goto 1"));
+    schedule_collection();
+    return;
+  }
+  if (g_str_has_suffix(file_name, ".gz")
+      || g_str_has_suffix(file_name, CORPUS_EXT)) {
+    gtk_entry_set_text(status, msg);
+    return;
+  }
   char board[NBOARD + 1];
   FILE *in = g_fopen(file_name, "r");
   if (!in) {
@@ -136,16 +196,43 @@ load_file(const char *file_name)
   fclose(in);
   board[n] = 0;
   set_status(interp_load(board));
+  schedule_collection();
+}
+
+/* Save a board and its history to a snapshot file. */
+
+static void
+save_snapshot(const char *file_name)
+{
+  char *data;
+  size_t n;
+  char *msg = interp_save_snapshot(&data, &n);
+  if (data) {
+    if (!g_file_set_contents(file_name, data, n, NULL)) {
+      gtk_entry_set_text(status, "failed to write file");
+      free(data); free(msg);
+      return;
+    }
+    free(data);
+  }
+  set_status(msg);
 }
 
-/* Save a board to a file. */
+/* Save a board to a file, as a snapshot when the file has the
+   snapshot extension, and as a grid of candidates when it has the
+   candidates extension. */
 
 static void
 save_file(const char *file_name)
 {
+  if (g_str_has_suffix(file_name, SNAPSHOT_EXT)) {
+    save_snapshot(file_name);
+    return;
+  }
   char *board;
-  char *msg = interp_save(&board);
-  if (*board) {
+  char *msg = interp_save(&board,
+			  g_str_has_suffix(file_name, BOARD_CANDIDATES_EXT));
+  if (board) {
     FILE *out = g_fopen(file_name, "w");
     if (!out) {
       gtk_entry_set_text(status, "failed to open file");
@@ -167,6 +254,7 @@ entry_callback(GtkWidget *widget, GtkWidget *entry)
   const gchar *cmd = gtk_entry_get_text(GTK_ENTRY(entry));
   set_status(interp_eval(cmd));
   gtk_entry_set_text(GTK_ENTRY(entry), "");
+  schedule_collection();
 }
 
 /* Menu bar support. */
@@ -209,6 +297,156 @@ save_file_as(void)
   gtk_widget_destroy(dialog);
 }
 
+/* Show how many solutions have been written, and end the dialog
+   when the search is done. */
+
+typedef struct {
+  enumeration *e;
+  GtkWidget *dialog;
+  GtkWidget *label;
+} progress;
+
+static gboolean
+show_progress(gpointer data)
+{
+  progress *p = data;
+  if (enumerate_done(p->e)) {
+    gtk_dialog_response(GTK_DIALOG(p->dialog), GTK_RESPONSE_ACCEPT);
+    return FALSE;
+  }
+  long count;
+  double seconds;
+  enumerate_progress(p->e, &count, &seconds);
+  gchar *text =
+    g_strdup_printf("%ld solutions in %.0f seconds, %.0f per second",
+		    count, seconds, seconds > 0 ? count / seconds : 0.0);
+  gtk_label_set_text(GTK_LABEL(p->label), text);
+  g_free(text);
+  return TRUE;
+}
+
+/* Run a search for solutions while showing its progress, with a
+   button that stops it. */
+
+static void
+run_enumeration(enumeration *e)
+{
+  GtkDialogFlags flags = GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT;
+  progress p;
+  p.e = e;
+  p.dialog = gtk_dialog_new_with_buttons("Saving Solutions",
+					 GTK_WINDOW(window),
+					 flags,
+					 "_Cancel",
+					 GTK_RESPONSE_CANCEL,
+					 NULL);
+  GtkWidget *content_area =
+    gtk_dialog_get_content_area(GTK_DIALOG(p.dialog));
+  p.label = gtk_label_new("Starting");
+  gtk_container_add_with_properties(GTK_CONTAINER(content_area), p.label,
+				    "expand", TRUE,
+				    "fill", TRUE,
+				    NULL);
+  gtk_widget_show_all(content_area);
+  g_timeout_add(250, show_progress, &p);
+  int cancelled = 0;
+  while (gtk_dialog_run(GTK_DIALOG(p.dialog)) != GTK_RESPONSE_ACCEPT) {
+    enumerate_cancel(e);	/* Cancelled or closed */
+    cancelled = 1;
+    gtk_dialog_set_response_sensitive(GTK_DIALOG(p.dialog),
+				      GTK_RESPONSE_CANCEL, FALSE);
+    gtk_label_set_text(GTK_LABEL(p.label), "Stopping");
+  }
+  gtk_widget_destroy(p.dialog);
+
+  long count;
+  double seconds;
+  int truncated;
+  const char *err = enumerate_finish(e, &count, &seconds, &truncated);
+  if (err) {
+    gtk_entry_set_text(status, err);
+    return;
+  }
+  gchar *text =
+    g_strdup_printf("%ld solutions in %.2f seconds, %.0f per second%s",
+		    count, seconds, seconds > 0 ? count / seconds : 0.0,
+		    truncated ? ", truncated as the corpus is full"
+		    : cancelled ? ", cancelled" : "");
+  gtk_entry_set_text(status, text);
+  g_free(text);
+}
+
+/* Ask before a search for every solution, which may never end. */
+
+static gboolean
+confirm_unlimited(void)
+{
+  GtkDialogFlags flags = GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT;
+  GtkWidget *dialog =
+    gtk_message_dialog_new(GTK_WINDOW(window), flags,
+			   GTK_MESSAGE_WARNING, GTK_BUTTONS_OK_CANCEL,
+			   "A board with few digits has more solutions "
+			   "than any disk can hold.  Write solutions "
+			   "until cancelled?");
+  gint response = gtk_dialog_run(GTK_DIALOG(dialog));
+  gtk_widget_destroy(dialog);
+  return response == GTK_RESPONSE_OK;
+}
+
+/* Write the solutions of the board to a file, as a packed corpus when
+   the file has the corpus extension.  The dialog asks for the most
+   solutions to write, with zero for all of them.  The solutions are
+   written in the background, and the search can be cancelled. */
+
+static void
+save_solutions(void)
+{
+  int vals[NCELLS];
+  char *msg = interp_get_vals(vals);
+  if (msg) {
+    set_status(msg);
+    return;
+  }
+  GtkWidget *dialog;
+  dialog = gtk_file_chooser_dialog_new("Save Solutions",
+				       GTK_WINDOW(window),
+				       GTK_FILE_CHOOSER_ACTION_SAVE,
+				       "_Cancel", GTK_RESPONSE_CANCEL,
+				       "_Save", GTK_RESPONSE_ACCEPT,
+				       NULL);
+  gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dialog),
+						 TRUE);
+  GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+  gtk_box_pack_start(GTK_BOX(box), gtk_label_new("Stop after"),
+		     FALSE, FALSE, 0);
+  GtkWidget *spin = gtk_spin_button_new_with_range(0, G_MAXINT, 1000);
+  gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin), 1000);
+  gtk_box_pack_start(GTK_BOX(box), spin, FALSE, FALSE, 0);
+  gtk_box_pack_start(GTK_BOX(box),
+		     gtk_label_new("solutions, or zero for all"),
+		     FALSE, FALSE, 0);
+  gtk_widget_show_all(box);
+  gtk_file_chooser_set_extra_widget(GTK_FILE_CHOOSER(dialog), box);
+  char *filename = NULL;
+  long limit = 0;
+  if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+    filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+    limit = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(spin));
+  }
+  gtk_widget_destroy(dialog);
+  if (!filename || (!limit && !confirm_unlimited())) {
+    g_free(filename);
+    return;
+  }
+  enumeration *e;
+  const char *err = enumerate_start(vals, filename, limit, &e);
+  g_free(filename);
+  if (err)
+    gtk_entry_set_text(status, err);
+  else
+    run_enumeration(e);
+}
+
 /* Help menu content. */
 
 static const char intro[] =
@@ -290,6 +528,8 @@ static GtkActionEntry main_entries[] = {
    "Open a file and load board", open_file},
   {"SaveAs", "Save _As", "Save _As", "<control>S",
    "Save a board in a file", save_file_as},
+  {"SaveSolutions", "Save So_lutions", "Save So_lutions", NULL,
+   "Save the solutions of a board in a file", save_solutions},
   {"Quit", "_Quit", "_Quit", "<control>Q",
    "Quit the program", gtk_main_quit},
   {"Intro", "_Intro", "_Intro", "<control>I",
@@ -304,6 +544,7 @@ static const char *main_ui_description =
   "    <menu action='FileMenu'>"
   "      <menuitem action='Open'/>"
   "      <menuitem action='SaveAs'/>"
+  "      <menuitem action='SaveSolutions'/>"
   "      <menuitem action='Quit'/>"
   "    </menu>"
   "    <menu action='HelpMenu'>"
@@ -337,6 +578,23 @@ get_menubar_menu(GtkWidget *window, const gchar *path,
   return gtk_ui_manager_get_widget(ui_manager, path);
 }
 
+/* Open the cache of solved puzzles in the user's cache directory.
+   The program runs without the cache when it cannot be opened. */
+
+static void
+open_cache(void)
+{
+  gchar *dir = g_build_filename(g_get_user_cache_dir(), PACKAGE, NULL);
+  if (!g_mkdir_with_parents(dir, 0755)) {
+    gchar *file_name = g_build_filename(dir, CACHE_FILE, NULL);
+    const char *msg = cache_open(file_name);
+    if (msg)
+      g_message("%s: %s", file_name, msg);
+    g_free(file_name);
+  }
+  g_free(dir);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -392,6 +650,8 @@ main(int argc, char *argv[])
     return EXIT_FAILURE;
   }
 
+  open_cache();
+
   if (argc > 1)
     load_file(argv[1]);
 
@@ -399,5 +659,7 @@ main(int argc, char *argv[])
 
   gtk_main();
 
+  interp_close();
+  cache_close();
   return 0;
 }
@@ -22,6 +22,8 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
 #include <ctype.h>
 #include "lua.h"
 #include "lauxlib.h"
@@ -29,6 +31,13 @@
 #include "config.h"
 #include "gtksudoku.h"
 #include "interp.h"
+#include "board.h"
+#include "cache.h"
+#include "pool.h"
+#include "puzzles.h"
+#include "rules.h"
+#include "snapshot.h"
+#include "solver.h"
 #include "sudoku.h"
 
 static char *
@@ -79,7 +88,1173 @@ show(lua_State *L)
   return 0;
 }
 
+/* Cells
+
+   A cell of the board is a userdata that holds a mask of the digits
+   still possible for the cell, with bit d - 1 set for digit d, and
+   whether its value has been determined.  Indexing a cell with digit
+   d gives true when d is possible, and assigning false to it
+   eliminates d.  The fields m and determined give the mask and the
+   flag.  Cells share a metatable that also holds their methods.  It
+   is available to the script as the global Cell, so the script can
+   add methods of its own. */
+
+#define CELL "Cell"
+
+typedef struct {
+  uint16_t mask;		/* Possible digits */
+  uint16_t determined;		/* Has the value been determined? */
+} cell;
+
+static cell *
+push_cell(lua_State *L)
+{
+  cell *c = (cell *)lua_newuserdata(L, sizeof(cell));
+  luaL_getmetatable(L, CELL);
+  lua_setmetatable(L, -2);
+  return c;
+}
+
+static uint16_t
+check_bit(lua_State *L, int narg)
+{
+  int d = luaL_checkint(L, narg);
+  luaL_argcheck(L, 1 <= d && d <= DIGITS, narg, "digit expected");
+  return 1 << (d - 1);
+}
+
+static int
+unknowns(uint16_t mask)
+{
+  int n;
+  for (n = 0; mask; mask &= mask - 1)
+    n++;
+  return n;
+}
+
+static int
+mk_cell(lua_State *L)
+{
+  cell *c = push_cell(L);
+  c->mask = ALL;
+  c->determined = 0;
+  return 1;
+}
+
+static int
+cell_clone(lua_State *L)
+{
+  cell *c = (cell *)luaL_checkudata(L, 1, CELL);
+  memcpy(push_cell(L), c, sizeof(cell));
+  return 1;
+}
+
+static int
+cell_same(lua_State *L)
+{
+  cell *c = (cell *)luaL_checkudata(L, 1, CELL);
+  if (lua_isnoneornil(L, 2))
+    lua_pushboolean(L, 0);
+  else
+    lua_pushboolean(L, !memcmp(c, luaL_checkudata(L, 2, CELL),
+			       sizeof(cell)));
+  return 1;
+}
+
+/* Is digit d still a possible value for the cell? */
+
+static int
+cell_has(lua_State *L)
+{
+  cell *c = (cell *)luaL_checkudata(L, 1, CELL);
+  lua_pushboolean(L, c->mask & check_bit(L, 2));
+  return 1;
+}
+
+/* Eliminate digit d, and return true if it was possible. */
+
+static int
+cell_remove(lua_State *L)
+{
+  cell *c = (cell *)luaL_checkudata(L, 1, CELL);
+  uint16_t bit = check_bit(L, 2);
+  lua_pushboolean(L, c->mask & bit);
+  c->mask &= ~bit;
+  return 1;
+}
+
+/* Does the cell have any of the digits in a mask as possible values? */
+
+static int
+cell_any(lua_State *L)
+{
+  cell *c = (cell *)luaL_checkudata(L, 1, CELL);
+  lua_pushboolean(L, c->mask & luaL_checkint(L, 2));
+  return 1;
+}
+
+/* Eliminate all digits not in a mask, provided the cell has a digit
+   in the mask.  Returns true when some possible values have been
+   eliminated. */
+
+static int
+cell_keep(lua_State *L)
+{
+  cell *c = (cell *)luaL_checkudata(L, 1, CELL);
+  uint16_t mask = c->mask & luaL_checkint(L, 2);
+  int e = mask && mask != c->mask;
+  if (e)
+    c->mask = mask;
+  lua_pushboolean(L, e);
+  return 1;
+}
+
+/* Eliminate all digits but d.  Returns true when some possible values
+   have been eliminated. */
+
+static int
+cell_singleton(lua_State *L)
+{
+  cell *c = (cell *)luaL_checkudata(L, 1, CELL);
+  uint16_t mask = c->mask & check_bit(L, 2);
+  lua_pushboolean(L, mask != c->mask);
+  c->mask = mask;
+  return 1;
+}
+
+static int
+cell_unknowns(lua_State *L)
+{
+  cell *c = (cell *)luaL_checkudata(L, 1, CELL);
+  lua_pushinteger(L, unknowns(c->mask));
+  return 1;
+}
+
+/* The least digit possible for the cell. */
+
+static int
+cell_first(lua_State *L)
+{
+  cell *c = (cell *)luaL_checkudata(L, 1, CELL);
+  int d;
+  if (!c->mask) {
+    lua_pushliteral(L, "Board inconsistent");
+    return lua_error(L);
+  }
+  for (d = 1; !(c->mask & 1 << (d - 1)); d++);
+  lua_pushinteger(L, d);
+  return 1;
+}
+
+static int
+cell_only_pair_present(lua_State *L)
+{
+  cell *c = (cell *)luaL_checkudata(L, 1, CELL);
+  uint16_t bit1 = check_bit(L, 2);
+  uint16_t bit2 = check_bit(L, 3);
+  lua_pushboolean(L, bit1 != bit2 && c->mask == (bit1 | bit2));
+  return 1;
+}
+
+static int
+cell_val(lua_State *L)
+{
+  cell *c = (cell *)luaL_checkudata(L, 1, CELL);
+  lua_pushinteger(L, c->mask);
+  return 1;
+}
+
+static int
+cell_index(lua_State *L)
+{
+  cell *c = (cell *)luaL_checkudata(L, 1, CELL);
+  if (lua_type(L, 2) == LUA_TNUMBER) {
+    int d = lua_tointeger(L, 2);
+    if (1 <= d && d <= DIGITS)
+      lua_pushboolean(L, c->mask & 1 << (d - 1));
+    else
+      lua_pushnil(L);
+    return 1;
+  }
+  size_t n;
+  const char *key = lua_tolstring(L, 2, &n);
+  if (n == 1 && key[0] == 'm')
+    lua_pushinteger(L, c->mask);
+  else if (n == 10 && !memcmp(key, "determined", n))
+    lua_pushboolean(L, c->determined);
+  else {			/* Look for a method */
+    lua_settop(L, 2);
+    lua_rawget(L, lua_upvalueindex(1));
+  }
+  return 1;
+}
+
+static int
+cell_newindex(lua_State *L)
+{
+  cell *c = (cell *)luaL_checkudata(L, 1, CELL);
+  if (lua_type(L, 2) == LUA_TNUMBER) {
+    uint16_t bit = check_bit(L, 2);
+    if (lua_toboolean(L, 3))
+      c->mask |= bit;
+    else
+      c->mask &= ~bit;
+    return 0;
+  }
+  const char *key = luaL_checkstring(L, 2);
+  if (!strcmp(key, "m"))
+    c->mask = luaL_checkint(L, 3) & ALL;
+  else if (!strcmp(key, "determined"))
+    c->determined = lua_toboolean(L, 3);
+  else
+    return luaL_error(L, "cell has no field %s", key);
+  return 0;
+}
+
+static const luaL_Reg cell_methods[] = {
+  {"clone", cell_clone},
+  {"same", cell_same},
+  {"has", cell_has},
+  {"remove", cell_remove},
+  {"any", cell_any},
+  {"keep", cell_keep},
+  {"singleton", cell_singleton},
+  {"unknowns", cell_unknowns},
+  {"first", cell_first},
+  {"only_pair_present", cell_only_pair_present},
+  {"val", cell_val},
+  {"__newindex", cell_newindex},
+  {NULL, NULL}
+};
+
+/* Boards as strings.  A board is a table of NCELLS cells in row
+   major order. */
+
+static const char *const board_forms[] = {
+  "line", "grid", "candidates", NULL
+};
+
+/* Get the cells of the board at index idx. */
+
+static void
+get_cells(lua_State *L, int idx, int vals[NCELLS], int determined[NCELLS])
+{
+  luaL_checktype(L, idx, LUA_TTABLE);
+  int i;
+  for (i = 0; i < NCELLS; i++) {
+    lua_rawgeti(L, idx, i + 1);
+    cell *c = (cell *)luaL_checkudata(L, -1, CELL);
+    vals[i] = c->mask;
+    determined[i] = c->determined;
+    lua_pop(L, 1);
+  }
+}
+
+/* Push a new board without a metatable. */
+
+static void
+push_cells(lua_State *L, const int vals[NCELLS], const int determined[NCELLS])
+{
+  lua_createtable(L, NCELLS, 0);
+  int i;
+  for (i = 0; i < NCELLS; i++) {
+    cell *c = push_cell(L);
+    c->mask = vals[i];
+    c->determined = determined[i];
+    lua_rawseti(L, -2, i + 1);
+  }
+}
+
+/* Write a board as a string in the form named by the second
+   argument. */
+
+static int
+pack_board(lua_State *L)
+{
+  int vals[NCELLS], determined[NCELLS];
+  char buf[BOARD_SIZE];
+  get_cells(L, 1, vals, determined);
+  int form = luaL_checkoption(L, 2, "line", board_forms);
+  lua_pushlstring(L, buf, board_write(buf, form, vals, determined));
+  return 1;
+}
+
+/* Read a board from a string, and return a table of its cells and
+   the name of the form read. */
+
+static int
+unpack_board(lua_State *L)
+{
+  int vals[NCELLS], determined[NCELLS];
+  const char *s = luaL_checkstring(L, 1);
+  int form = board_read(s, vals, determined);
+  if (form < 0) {
+    lua_pushfstring(L, "bad input: expected %d items but found %d in \n%s",
+		    NCELLS, (int)boardlen(s), s);
+    return lua_error(L);
+  }
+  push_cells(L, vals, determined);
+  lua_pushstring(L, board_forms[form]);
+  return 2;
+}
+
+/* Rules in C.  A rule gets the cells of a board, works on a copy
+   of their masks, and writes back the masks it changed. */
+
+/* Store the masks of a board into the cells at index idx. */
+
+static void
+put_cells(lua_State *L, int idx, const int vals[NCELLS])
+{
+  int i;
+  for (i = 0; i < NCELLS; i++) {
+    lua_rawgeti(L, idx, i + 1);
+    cell *c = (cell *)lua_touserdata(L, -1);
+    c->mask = vals[i];
+    lua_pop(L, 1);
+  }
+}
+
+/* Get the house at index 2 and the set of digits that follow it.
+   Returns zero when a digit is repeated. */
+
+static int
+get_subset(lua_State *L, int *h)
+{
+  *h = luaL_checkint(L, 2);
+  luaL_argcheck(L, 1 <= *h && *h <= NHOUSES, 2, "house expected");
+  (*h)--;
+  int set = 0;
+  int k;
+  for (k = 3; k <= lua_gettop(L); k++) {
+    uint16_t bit = check_bit(L, k);
+    if (set & bit)
+      return 0;
+    set |= bit;
+  }
+  return set;
+}
+
+typedef int (*subset_rule)(grid *g, int h, int set);
+
+static int
+apply_subset(lua_State *L, subset_rule rule)
+{
+  grid g;
+  int h;
+  get_cells(L, 1, g.vals, g.determined);
+  int set = get_subset(L, &h);
+  int e = set && rule(&g, h, set);
+  if (e)
+    put_cells(L, 1, g.vals);
+  lua_pushboolean(L, e);
+  return 1;
+}
+
+/* Apply the naked subset rule to the board, the house, and the digits
+   given as arguments. */
+
+static int
+naked_subset_rule(lua_State *L)
+{
+  return apply_subset(L, naked_subset);
+}
+
+/* Apply the hidden subset rule to the board, the house, and the
+   digits given as arguments. */
+
+static int
+hidden_subset_rule(lua_State *L)
+{
+  return apply_subset(L, hidden_subset);
+}
+
+/* Apply the first naked or hidden subset of n digits found in the
+   board.  Returns "naked" or "hidden", the house, and the digits, or
+   nothing when there is none. */
+
+static int
+find_subset_rule(lua_State *L)
+{
+  grid g;
+  int h, set;
+  get_cells(L, 1, g.vals, g.determined);
+  int kind = find_subset(&g, luaL_checkint(L, 2), &h, &set);
+  if (!kind)
+    return 0;
+  put_cells(L, 1, g.vals);
+  lua_pushstring(L, kind == NAKED_SUBSET ? "naked" : "hidden");
+  lua_pushinteger(L, h + 1);
+  int n = 2;
+  int d;
+  for (d = 1; d <= DIGITS; d++)
+    if (set & 1 << (d - 1)) {
+      lua_pushinteger(L, d);
+      n++;
+    }
+  return n;
+}
+
+static const char *const fish_kinds[] = {
+  "row", "column", NULL
+};
+
+/* Apply the fish rule to the board, digit, kind of lines, and
+   finned flag given as arguments, with the lines of the base
+   following them. */
+
+static int
+fish_rule(lua_State *L)
+{
+  grid g;
+  get_cells(L, 1, g.vals, g.determined);
+  int d = luaL_checkint(L, 2);
+  luaL_argcheck(L, 1 <= d && d <= DIGITS, 2, "digit expected");
+  int kind = ROW_FISH + luaL_checkoption(L, 3, NULL, fish_kinds);
+  int finned = lua_toboolean(L, 4);
+  int base = 0;
+  int k;
+  for (k = 5; k <= lua_gettop(L); k++) {
+    uint16_t bit = check_bit(L, k);
+    if (base & bit) {
+      lua_pushboolean(L, 0);	/* Line repeated */
+      return 1;
+    }
+    base |= bit;
+  }
+  int e = fish(&g, d, kind, base, finned);
+  if (e)
+    put_cells(L, 1, g.vals);
+  lua_pushboolean(L, e);
+  return 1;
+}
+
+/* Apply the first fish with n lines in its base found in the board,
+   finned when the third argument is true.  Returns "row" or "column",
+   the digit, and the lines of the base, or nothing when there is
+   none. */
+
+static int
+find_fish_rule(lua_State *L)
+{
+  grid g;
+  int d, base;
+  get_cells(L, 1, g.vals, g.determined);
+  int kind = find_fish(&g, luaL_checkint(L, 2), lua_toboolean(L, 3),
+		       &d, &base);
+  if (!kind)
+    return 0;
+  put_cells(L, 1, g.vals);
+  lua_pushstring(L, fish_kinds[kind - ROW_FISH]);
+  lua_pushinteger(L, d);
+  int n = 2;
+  int l;
+  for (l = 1; l <= DIGITS; l++)
+    if (base & 1 << (l - 1)) {
+      lua_pushinteger(L, l);
+      n++;
+    }
+  return n;
+}
+
+/* Get a cell index at narg, and return it numbered from zero. */
+
+static int
+check_cell(lua_State *L, int narg)
+{
+  int i = luaL_checkint(L, narg);
+  luaL_argcheck(L, 1 <= i && i <= NCELLS, narg, "cell expected");
+  return i - 1;
+}
+
+typedef int (*wing_rule)(grid *g, int x, int a, int b);
+
+static int
+apply_wing(lua_State *L, wing_rule rule, int x)
+{
+  grid g;
+  get_cells(L, 1, g.vals, g.determined);
+  int e = rule(&g, x, check_cell(L, 3), check_cell(L, 4));
+  if (e)
+    put_cells(L, 1, g.vals);
+  lua_pushboolean(L, e);
+  return 1;
+}
+
+/* Apply the XY-Wing rule to the board, pivot, and pincers given as
+   arguments. */
+
+static int
+xy_wing_rule(lua_State *L)
+{
+  return apply_wing(L, xy_wing, check_cell(L, 2));
+}
+
+/* Apply the XYZ-Wing rule to the board, pivot, and pincers given as
+   arguments. */
+
+static int
+xyz_wing_rule(lua_State *L)
+{
+  return apply_wing(L, xyz_wing, check_cell(L, 2));
+}
+
+/* Apply the W-Wing rule to the board, the digit of the link, and the
+   two cells given as arguments. */
+
+static int
+w_wing_rule(lua_State *L)
+{
+  int d = luaL_checkint(L, 2);
+  luaL_argcheck(L, 1 <= d && d <= DIGITS, 2, "digit expected");
+  return apply_wing(L, w_wing, d);
+}
+
+static const char *const wing_kinds[] = {
+  "xy", "xyz", "w", NULL
+};
+
+/* Apply the first wing of the kind named by the second argument
+   found in the board.  Returns the digit and the cells of the wing,
+   or nothing when there is none. */
+
+static int
+find_wing_rule(lua_State *L)
+{
+  grid g;
+  int cells[3], d;
+  get_cells(L, 1, g.vals, g.determined);
+  int kind = XY_WING + luaL_checkoption(L, 2, NULL, wing_kinds);
+  if (!find_wing(&g, kind, cells, &d))
+    return 0;
+  put_cells(L, 1, g.vals);
+  int n = kind == W_WING ? 2 : 3;
+  int k;
+  lua_pushinteger(L, d);
+  for (k = 0; k < n; k++)
+    lua_pushinteger(L, cells[k] + 1);
+  return n + 1;
+}
+
+/* Apply simple coloring to the board, digit, and cell given as
+   arguments. */
+
+static int
+coloring_rule(lua_State *L)
+{
+  grid g;
+  get_cells(L, 1, g.vals, g.determined);
+  int d = luaL_checkint(L, 2);
+  luaL_argcheck(L, 1 <= d && d <= DIGITS, 2, "digit expected");
+  int e = coloring(&g, d, check_cell(L, 3));
+  if (e)
+    put_cells(L, 1, g.vals);
+  lua_pushboolean(L, e);
+  return 1;
+}
+
+/* Apply the first simple coloring found in the board, for the digit
+   given as the second argument, or for any digit when it is absent.
+   Returns the digit and the cell the coloring started from, or
+   nothing when there is none. */
+
+static int
+find_coloring_rule(lua_State *L)
+{
+  grid g;
+  int start;
+  get_cells(L, 1, g.vals, g.determined);
+  int d = find_coloring(&g, luaL_optint(L, 2, 0), &start);
+  if (!d)
+    return 0;
+  put_cells(L, 1, g.vals);
+  lua_pushinteger(L, d);
+  lua_pushinteger(L, start + 1);
+  return 2;
+}
+
+/* Apply the first chain found in the board, using only the digit
+   given as the second argument, or any digit when it is absent.
+   Returns the cell and digit of each candidate in the chain, in
+   order, or nothing when there is none. */
+
+static int
+find_chain_rule(lua_State *L)
+{
+  grid g;
+  int chain[MAX_CHAIN];
+  get_cells(L, 1, g.vals, g.determined);
+  int n = find_chain(&g, luaL_optint(L, 2, 0), chain);
+  if (!n)
+    return 0;
+  put_cells(L, 1, g.vals);
+  luaL_checkstack(L, 2 * n, "chain too long");
+  int k;
+  for (k = 0; k < n; k++) {
+    lua_pushinteger(L, chain[k] / DIGITS + 1);
+    lua_pushinteger(L, chain[k] % DIGITS + 1);
+  }
+  return 2 * n;
+}
+
+static const char *const als_kinds[] = {
+  "xz", "xy", NULL
+};
+
+/* Push a table of the digits in a mask. */
+
+static void
+push_digits(lua_State *L, int mask)
+{
+  int d, n = 0;
+  lua_newtable(L);
+  for (d = 1; d <= DIGITS; d++)
+    if (mask & 1 << (d - 1)) {
+      lua_pushinteger(L, d);
+      lua_rawseti(L, -2, ++n);
+    }
+}
+
+/* Apply the first rule about almost locked sets of the kind named by
+   the second argument found in the board, giving up after the number
+   of steps given as the third argument, unless it is absent or zero.
+   Returns a table of the sets, each a table of cells, the digits x
+   and y, and a table of the digits eliminated, or nothing when there
+   is none.  For "xz", y is false. */
+
+static int
+find_als_rule(lua_State *L)
+{
+  grid g;
+  als_set sets[3];
+  int x, y, z;
+  get_cells(L, 1, g.vals, g.determined);
+  int kind = ALS_XZ + luaL_checkoption(L, 2, NULL, als_kinds);
+  long budget = luaL_optlong(L, 3, 0);
+  if (!find_als(&g, kind, budget, sets, &x, &y, &z))
+    return 0;
+  put_cells(L, 1, g.vals);
+  int n = kind == ALS_XZ ? 2 : 3;
+  int j, k;
+  lua_createtable(L, n, 0);
+  for (j = 0; j < n; j++) {
+    lua_createtable(L, sets[j].n, 0);
+    for (k = 0; k < sets[j].n; k++) {
+      lua_pushinteger(L, sets[j].cells[k] + 1);
+      lua_rawseti(L, -2, k + 1);
+    }
+    lua_rawseti(L, -2, j + 1);
+  }
+  lua_pushinteger(L, x);
+  if (y)
+    lua_pushinteger(L, y);
+  else
+    lua_pushboolean(L, 0);
+  push_digits(L, z);
+  return 4;
+}
+
+/* Apply the unique rectangle rules to the board and the opposite
+   corners given as arguments.  Returns the type applied, or false. */
+
+static int
+unique_rectangle_rule(lua_State *L)
+{
+  grid g;
+  get_cells(L, 1, g.vals, g.determined);
+  int type = unique_rectangle(&g, check_cell(L, 2), check_cell(L, 3));
+  if (!type) {
+    lua_pushboolean(L, 0);
+    return 1;
+  }
+  put_cells(L, 1, g.vals);
+  lua_pushinteger(L, type);
+  return 1;
+}
+
+/* Apply the first unique rectangle found in the board.  Returns its
+   type and opposite corners, or nothing when there is none. */
+
+static int
+find_unique_rectangle_rule(lua_State *L)
+{
+  grid g;
+  int a, d;
+  get_cells(L, 1, g.vals, g.determined);
+  int type = find_unique_rectangle(&g, &a, &d);
+  if (!type)
+    return 0;
+  put_cells(L, 1, g.vals);
+  lua_pushinteger(L, type);
+  lua_pushinteger(L, a + 1);
+  lua_pushinteger(L, d + 1);
+  return 3;
+}
+
+/* Apply BUG+1 to the board.  Returns the digit and its cell, or
+   nothing when the rule does not apply. */
+
+static int
+bug_plus_one_rule(lua_State *L)
+{
+  grid g;
+  int cell;
+  get_cells(L, 1, g.vals, g.determined);
+  int d = bug_plus_one(&g, &cell);
+  if (!d)
+    return 0;
+  put_cells(L, 1, g.vals);
+  lua_pushinteger(L, d);
+  lua_pushinteger(L, cell + 1);
+  return 2;
+}
+
+/* Push the cells in a list, numbered from one. */
+
+static int
+push_cell_list(lua_State *L, int n, const int cells[])
+{
+  luaL_checkstack(L, n, "too many cells");
+  int k;
+  for (k = 0; k < n; k++)
+    lua_pushinteger(L, cells[k] + 1);
+  return n;
+}
+
+/* Apply the pattern overlay method to the board for the digit given
+   as the second argument.  Returns the cells from which the digit was
+   eliminated, or nothing when there are none. */
+
+static int
+pattern_overlay_rule(lua_State *L)
+{
+  grid g;
+  int cells[NCELLS];
+  get_cells(L, 1, g.vals, g.determined);
+  int d = luaL_checkint(L, 2);
+  luaL_argcheck(L, 1 <= d && d <= DIGITS, 2, "digit expected");
+  int n = pattern_overlay(&g, d, cells);
+  if (n)
+    put_cells(L, 1, g.vals);
+  return push_cell_list(L, n, cells);
+}
+
+/* Apply the pattern overlay method to each digit of the board until
+   one is eliminated.  Returns the digit and the cells from which it
+   was eliminated, or nothing when there is none. */
+
+static int
+find_pattern_overlay_rule(lua_State *L)
+{
+  grid g;
+  int d, cells[NCELLS];
+  get_cells(L, 1, g.vals, g.determined);
+  int n = find_pattern_overlay(&g, &d, cells);
+  if (!n)
+    return 0;
+  put_cells(L, 1, g.vals);
+  lua_pushinteger(L, d);
+  return 1 + push_cell_list(L, n, cells);
+}
+
+/* Push a forcing chain as a table of the cell and digit of each
+   step, in order, followed by "cell" and the cell with no digit left,
+   or "house", the house, and the digit with no place in it. */
+
+static int
+push_forcing_chain(lua_State *L, const forcing_chain *fc)
+{
+  int k;
+  lua_createtable(L, 2 * fc->n, 0);
+  for (k = 0; k < fc->n; k++) {
+    lua_pushinteger(L, fc->cells[k] + 1);
+    lua_rawseti(L, -2, 2 * k + 1);
+    lua_pushinteger(L, fc->digits[k]);
+    lua_rawseti(L, -2, 2 * k + 2);
+  }
+  if (fc->kind == NO_DIGIT) {
+    lua_pushliteral(L, "cell");
+    lua_pushinteger(L, fc->where + 1);
+    return 3;
+  }
+  lua_pushliteral(L, "house");
+  lua_pushinteger(L, fc->where + 1);
+  lua_pushinteger(L, fc->digit);
+  return 4;
+}
+
+/* Try the digit given as the third argument in the cell given as the
+   second.  When it leads to a contradiction, it is eliminated, and
+   the forcing chain is returned, else nothing is. */
+
+static int
+nishio_rule(lua_State *L)
+{
+  grid g;
+  forcing_chain fc;
+  get_cells(L, 1, g.vals, g.determined);
+  int i = check_cell(L, 2);
+  int d = luaL_checkint(L, 3);
+  luaL_argcheck(L, 1 <= d && d <= DIGITS, 3, "digit expected");
+  if (!nishio(&g, i, d, &fc))
+    return 0;
+  put_cells(L, 1, g.vals);
+  return push_forcing_chain(L, &fc);
+}
+
+/* Try every candidate on the board, and eliminate the one with the
+   shortest forcing chain to a contradiction.  Returns the chain, or
+   nothing when there is none. */
+
+static int
+find_nishio_rule(lua_State *L)
+{
+  grid g;
+  forcing_chain fc;
+  get_cells(L, 1, g.vals, g.determined);
+  if (!find_nishio(&g, &fc))
+    return 0;
+  put_cells(L, 1, g.vals);
+  return push_forcing_chain(L, &fc);
+}
+
+/* Count the solutions of the board, stopping at the limit given as
+   the second argument, which defaults to two.  Returns the count, and
+   a table of the digits of each of the first two solutions found. */
+
+static int
+count_solutions(lua_State *L)
+{
+  int vals[NCELLS], determined[NCELLS], solutions[2][NCELLS];
+  get_cells(L, 1, vals, determined);
+  int limit = luaL_optint(L, 2, 2);
+  int n = solver_count(vals, limit, solutions);
+  lua_pushinteger(L, n);
+  int j, i;
+  for (j = 0; j < n && j < 2; j++) {
+    lua_createtable(L, NCELLS, 0);
+    for (i = 0; i < NCELLS; i++) {
+      lua_pushinteger(L, solutions[j][i]);
+      lua_rawseti(L, -2, i + 1);
+    }
+  }
+  return 1 + j;
+}
+
+/* Return puzzle n of the collection, or nil when there is no such
+   puzzle. */
+
+static int
+get_puzzle(lua_State *L)
+{
+  size_t len;
+  const char *s = puzzles_get(luaL_checkint(L, 1), &len);
+  if (s)
+    lua_pushlstring(L, s, len);
+  else
+    lua_pushnil(L);
+  return 1;
+}
+
+/* Look up the puzzle with the given clues in the cache of solved
+   puzzles.  Return the board as solved, its difficulty, and its
+   steps, or nothing on a miss. */
+
+static int
+lookup_solution(lua_State *L)
+{
+  int vals[NCELLS], determined[NCELLS];
+  size_t len;
+  const char *clues = luaL_checklstring(L, 1, &len);
+  luaL_argcheck(L, len == NCELLS, 1, "not a board");
+  int difficulty, steps;
+  if (!cache_lookup(clues, vals, determined, &difficulty, &steps))
+    return 0;
+  push_cells(L, vals, determined);
+  lua_pushinteger(L, difficulty);
+  lua_pushinteger(L, steps);
+  return 3;
+}
+
+/* Record the board solved from the puzzle with the given clues, with
+   its difficulty and steps. */
+
+static int
+store_solution(lua_State *L)
+{
+  int vals[NCELLS], determined[NCELLS];
+  size_t len;
+  const char *clues = luaL_checklstring(L, 1, &len);
+  luaL_argcheck(L, len == NCELLS, 1, "not a board");
+  get_cells(L, 2, vals, determined);
+  cache_store(clues, vals, determined,
+	      luaL_checkint(L, 3), luaL_checkint(L, 4));
+  return 0;
+}
+
+/* Write a snapshot of the details flag, the history of boards, and
+   the current board, given in that order. */
+
+static int
+pack_snapshot(lua_State *L)
+{
+  int vals[NCELLS], determined[NCELLS];
+  int details = lua_toboolean(L, 1);
+  luaL_checktype(L, 2, LUA_TTABLE);
+  int n = lua_objlen(L, 2);
+  if (n >= SNAPSHOT_MAX_BOARDS) {
+    lua_pushliteral(L, "history too long to save");
+    return lua_error(L);
+  }
+  unsigned char *buf = lua_newuserdata(L, snapshot_size(n + 1));
+  int k;
+  for (k = 0; k < n; k++) {
+    lua_rawgeti(L, 2, k + 1);
+    get_cells(L, lua_gettop(L), vals, determined);
+    lua_pop(L, 1);
+    snapshot_put(buf, k, vals, determined);
+  }
+  get_cells(L, 3, vals, determined);
+  snapshot_put(buf, n, vals, determined);
+  snapshot_seal(buf, details, n + 1);
+  lua_pushlstring(L, (const char *)buf, snapshot_size(n + 1));
+  return 1;
+}
+
+/* Read a snapshot, and return the current board, the history of
+   boards, and the details flag. */
+
+static int
+unpack_snapshot(lua_State *L)
+{
+  int vals[NCELLS], determined[NCELLS];
+  size_t len;
+  const unsigned char *buf =
+    (const unsigned char *)luaL_checklstring(L, 1, &len);
+  int details, n;
+  const char *msg = snapshot_open(buf, len, &details, &n);
+  if (msg) {
+    lua_pushstring(L, msg);
+    return lua_error(L);
+  }
+  snapshot_get(buf, n - 1, vals, determined);
+  push_cells(L, vals, determined);
+  lua_createtable(L, n - 1, 0);
+  int k;
+  for (k = 0; k < n - 1; k++) {
+    snapshot_get(buf, k, vals, determined);
+    push_cells(L, vals, determined);
+    lua_rawseti(L, -2, k + 1);
+  }
+  lua_pushboolean(L, details);
+  return 3;
+}
+
 static lua_State *L;
+static pool *blocks;		/* The pool the blocks of L come from */
+
+/* Allocation accounting.  The interpreter's allocator obtains blocks
+   from a size class pool, counts the blocks it hands out and takes
+   back, and tracks the bytes in use.
+   The counters in command are reset at the start of each command, and
+   are copied into last when the next command starts, so that the mem
+   command can report on the command that preceded it. */
+
+struct alloc_stats {
+  size_t allocs;		/* Number of blocks allocated */
+  size_t frees;			/* Number of blocks freed */
+  size_t peak;			/* High-water mark of bytes in use */
+};
+
+static size_t in_use;		/* Bytes in use */
+static struct alloc_stats total, command, last;
+
+static void *
+counting_alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+  if (nsize == 0) {
+    if (ptr) {
+      total.frees++;
+      command.frees++;
+      in_use -= osize;
+    }
+    return pool_alloc(ud, ptr, osize, nsize);
+  }
+  void *p = pool_alloc(ud, ptr, osize, nsize);
+  if (!p)
+    return NULL;
+  if (!ptr) {
+    total.allocs++;
+    command.allocs++;
+  }
+  in_use += nsize - osize;	/* osize is zero when ptr is NULL */
+  if (in_use > total.peak)
+    total.peak = in_use;
+  if (in_use > command.peak)
+    command.peak = in_use;
+  return p;
+}
+
+/* The collector is held back while a command runs, so that
+   collection does not add to the time it takes to respond to a
+   command.  Garbage is collected between commands, when the bytes in
+   use reach GC_PAUSE percent of the bytes in use at the end of the
+   previous cycle.  So that a long command, such as solve, cannot
+   grow the heap without bound, the collector runs during a command
+   once the bytes in use reach GC_LIMIT percent of that size, and
+   then keeps running at its own pace until the command ends.
+
+   The collector runs in generational mode, in which a cycle is a
+   minor collection that only marks and sweeps the objects created
+   since the previous cycle, such as the boards pushed on the history
+   and the strings in messages, or now and then a major collection
+   of everything.  Either is done whole, as a step of the collector
+   in generational mode cannot stop part way through a cycle, so each
+   call of interp_collect runs a complete cycle or none. */
+
+/* Start a cycle when the bytes in use reach this percent of the
+   bytes in use after the last cycle. */
+#define GC_PAUSE 120
+/* Collect during a command when the bytes in use reach this percent
+   of the bytes in use after the last cycle. */
+#define GC_LIMIT 400
+/* The least limit, in kilobytes. */
+#define GC_LIMIT_MIN 1024
+
+static size_t estimate;		/* Bytes in use after the last cycle */
+
+static void
+start_command(void)
+{
+  size_t limit = estimate / 1024 / 100 * GC_LIMIT;
+  if (limit < GC_LIMIT_MIN)
+    limit = GC_LIMIT_MIN;
+  if (limit > INT_MAX)
+    limit = INT_MAX;
+  lua_gc(L, LUA_GCSETLIMIT, limit);
+  last = command;
+  command.allocs = 0;
+  command.frees = 0;
+  command.peak = in_use;
+}
+
+static void
+set_number(lua_State *L, const char *key, size_t n)
+{
+  lua_pushnumber(L, (lua_Number)n);
+  lua_setfield(L, -2, key);
+}
+
+static int
+mem_stats(lua_State *L)
+{
+  lua_createtable(L, 0, 7);
+  set_number(L, "in_use", in_use);
+  set_number(L, "peak", total.peak);
+  set_number(L, "allocs", total.allocs);
+  set_number(L, "frees", total.frees);
+  set_number(L, "last_peak", last.peak);
+  set_number(L, "last_allocs", last.allocs);
+  set_number(L, "last_frees", last.frees);
+  return 1;
+}
+
+/* Heap census.  The census walks every object reachable from the
+   registry and the globals, and counts the objects that have a
+   metatable by the name the first argument associates with the
+   metatable.  Objects with a metatable not in the first argument are
+   counted as other, tables without one are counted as plain, and
+   userdata without one are not counted.  The census is returned as a
+   table mapping names to counts. */
+
+#define CENSUS_NAMES 1
+#define CENSUS_SEEN 2
+#define CENSUS_COUNTS 3
+
+static void
+census_count(lua_State *L, const char *kind)
+{
+  if (lua_getmetatable(L, -1)) {
+    lua_rawget(L, CENSUS_NAMES);
+    kind = lua_isstring(L, -1) ? lua_tostring(L, -1) : "other";
+  }
+  else
+    lua_pushnil(L);
+  if (kind) {
+    lua_getfield(L, CENSUS_COUNTS, kind);
+    lua_Number n = lua_tonumber(L, -1);
+    lua_pop(L, 1);
+    lua_pushnumber(L, n + 1);
+    lua_setfield(L, CENSUS_COUNTS, kind);
+  }
+  lua_pop(L, 1);
+}
+
+/* Visit the value on the top of the stack, and pop it. */
+
+static void
+census_visit(lua_State *L)
+{
+  int type = lua_type(L, -1);
+  if (type != LUA_TTABLE && type != LUA_TFUNCTION
+      && type != LUA_TUSERDATA) {
+    lua_pop(L, 1);
+    return;
+  }
+  lua_pushvalue(L, -1);
+  lua_rawget(L, CENSUS_SEEN);
+  int seen = lua_toboolean(L, -1);
+  lua_pop(L, 1);
+  if (seen) {
+    lua_pop(L, 1);
+    return;
+  }
+  lua_pushvalue(L, -1);
+  lua_pushboolean(L, 1);
+  lua_rawset(L, CENSUS_SEEN);
+  luaL_checkstack(L, 8, "census too deep");
+  const char *name;
+  int i;
+  switch (type) {
+  case LUA_TTABLE:
+    census_count(L, "plain");
+    lua_pushnil(L);
+    while (lua_next(L, -2)) {
+      lua_pushvalue(L, -2);
+      census_visit(L);		/* Visit the key */
+      census_visit(L);		/* Visit the value */
+    }
+    break;
+  case LUA_TFUNCTION:
+    for (i = 1; (name = lua_getupvalue(L, -1, i)); i++)
+      census_visit(L);
+    lua_getfenv(L, -1);
+    census_visit(L);
+    break;
+  case LUA_TUSERDATA:
+    census_count(L, NULL);
+    lua_getfenv(L, -1);
+    census_visit(L);
+    break;
+  }
+  if (lua_getmetatable(L, -1))
+    census_visit(L);
+  lua_pop(L, 1);
+}
+
+static int
+census(lua_State *L)
+{
+  luaL_checktype(L, CENSUS_NAMES, LUA_TTABLE);
+  lua_settop(L, CENSUS_NAMES);
+  lua_newtable(L);		/* Seen objects */
+  lua_newtable(L);		/* Counts */
+  lua_pushvalue(L, LUA_REGISTRYINDEX);
+  census_visit(L);
+  lua_pushvalue(L, LUA_GLOBALSINDEX);
+  census_visit(L);
+  return 1;
+}
 
 static void
 push_item(lua_State *L, const char *cmd, const char *tail)
@@ -93,6 +1268,16 @@ push_item(lua_State *L, const char *cmd, const char *tail)
   lua_pushinteger(L, atoi(cmd));
 }
 
+/* Pop a result off the stack, and return a malloced copy of it. */
+
+static char *
+pop_string(lua_State *L)
+{
+  char *s = clone(lua_tostring(L, -1));
+  lua_pop(L, 1);
+  return s;
+}
+
 char *
 interp_eval(const char *cmd)
 {
@@ -100,6 +1285,7 @@ interp_eval(const char *cmd)
     cmd++;
   if (!*cmd)			/* If nothing left, silently exit */
     return NULL;
+  start_command();
   lua_getglobal(L, "eval");
   int nargs = 0;
   for (;;) {
@@ -119,47 +1305,192 @@ interp_eval(const char *cmd)
     }
   }
   lua_pcall(L, nargs, 1, 0);
-  return clone(lua_tostring(L, -1));
+  return pop_string(L);
 }
 
 char *
 interp_load(const char *board)
 {
+  start_command();
   lua_getglobal(L, "load");
   lua_pushstring(L, board);
   if (lua_pcall(L, 1, 0, 0))
-    return clone(lua_tostring(L, -1));
+    return pop_string(L);
   else
     return NULL;
 }
 
 char *
-interp_save(char **board)
+interp_save(char **board, int candidates)
 {
+  start_command();
   lua_getglobal(L, "save");
-  if (lua_pcall(L, 0, 1, 0)) {
+  lua_pushboolean(L, candidates);
+  if (lua_pcall(L, 1, 1, 0)) {
     *board = NULL;
-    return clone(lua_tostring(L, -1));
+    return pop_string(L);
+  }
+  else {
+    *board = pop_string(L);
+    return NULL;
+  }
+}
+
+char *
+interp_get_vals(int vals[])
+{
+  start_command();
+  lua_getglobal(L, "candidates");
+  if (lua_pcall(L, 0, 1, 0))
+    return pop_string(L);
+  int determined[NCELLS];
+  int form = board_read(lua_tostring(L, -1), vals, determined);
+  lua_pop(L, 1);
+  return form < 0 ? clone("bad board") : NULL;
+}
+
+char *
+interp_load_snapshot(const char *data, size_t n)
+{
+  start_command();
+  lua_getglobal(L, "load_snapshot");
+  lua_pushlstring(L, data, n);
+  if (lua_pcall(L, 1, 0, 0))
+    return pop_string(L);
+  else
+    return NULL;
+}
+
+char *
+interp_save_snapshot(char **data, size_t *n)
+{
+  start_command();
+  lua_getglobal(L, "save_snapshot");
+  if (lua_pcall(L, 0, 1, 0)) {
+    *data = NULL;
+    *n = 0;
+    return pop_string(L);
   }
   else {
-    *board = clone(lua_tostring(L, -1));
+    const char *s = lua_tolstring(L, -1, n);
+    *data = malloc(*n);
+    if (!*data) {
+      fprintf(stderr, "Memory allocation failed\n");
+      exit(1);
+    }
+    memcpy(*data, s, *n);
+    lua_pop(L, 1);
     return NULL;
   }
 }
 
+void
+interp_collect(void)
+{
+  if (in_use / GC_PAUSE * 100 < estimate)
+    return;
+  lua_gc(L, LUA_GCSTEP, 0);	/* A whole cycle */
+  lua_gc(L, LUA_GCSTOP, 0);
+  estimate = in_use;
+}
+
+static int
+panic(lua_State *L)
+{
+  fprintf(stderr, "Lua panic: %s\n", lua_tostring(L, -1));
+  return 0;
+}
+
 char *
 interp_init(void)
 {
-  L = luaL_newstate();
-  if (!L)
+  blocks = pool_new();
+  if (blocks)
+    L = lua_newstate(counting_alloc, blocks);
+  if (!L) {
+    pool_free(blocks);
+    blocks = NULL;
     return clone("Failed to create a Lua interpreter");
+  }
+  lua_atpanic(L, panic);
+  lua_gc(L, LUA_GCGEN, 0);
+  lua_gc(L, LUA_GCSTOP, 0);	/* Until the first command */
   luaL_openlibs(L);		/* Load libraries */
+  rules_init();
   lua_pushcfunction(L, set_val);
   lua_setglobal(L, "set_val");
   lua_pushcfunction(L, edit);
   lua_setglobal(L, "edit");
   lua_pushcfunction(L, show);
   lua_setglobal(L, "show");
+  lua_pushcfunction(L, mem_stats);
+  lua_setglobal(L, "mem_stats");
+  lua_pushcfunction(L, census);
+  lua_setglobal(L, "census");
+  lua_pushcfunction(L, mk_cell);
+  lua_setglobal(L, "mk_cell");
+  lua_pushcfunction(L, pack_board);
+  lua_setglobal(L, "pack_board");
+  lua_pushcfunction(L, unpack_board);
+  lua_setglobal(L, "unpack_board");
+  lua_pushcfunction(L, lookup_solution);
+  lua_setglobal(L, "lookup_solution");
+  lua_pushcfunction(L, store_solution);
+  lua_setglobal(L, "store_solution");
+  lua_pushcfunction(L, get_puzzle);
+  lua_setglobal(L, "puzzle");
+  lua_pushcfunction(L, pack_snapshot);
+  lua_setglobal(L, "pack_snapshot");
+  lua_pushcfunction(L, unpack_snapshot);
+  lua_setglobal(L, "unpack_snapshot");
+  lua_pushcfunction(L, naked_subset_rule);
+  lua_setglobal(L, "naked_subset");
+  lua_pushcfunction(L, hidden_subset_rule);
+  lua_setglobal(L, "hidden_subset");
+  lua_pushcfunction(L, find_subset_rule);
+  lua_setglobal(L, "find_subset");
+  lua_pushcfunction(L, fish_rule);
+  lua_setglobal(L, "fish");
+  lua_pushcfunction(L, find_fish_rule);
+  lua_setglobal(L, "find_fish");
+  lua_pushcfunction(L, xy_wing_rule);
+  lua_setglobal(L, "xy_wing");
+  lua_pushcfunction(L, xyz_wing_rule);
+  lua_setglobal(L, "xyz_wing");
+  lua_pushcfunction(L, w_wing_rule);
+  lua_setglobal(L, "w_wing");
+  lua_pushcfunction(L, find_wing_rule);
+  lua_setglobal(L, "find_wing");
+  lua_pushcfunction(L, coloring_rule);
+  lua_setglobal(L, "coloring");
+  lua_pushcfunction(L, find_coloring_rule);
+  lua_setglobal(L, "find_coloring");
+  lua_pushcfunction(L, find_chain_rule);
+  lua_setglobal(L, "find_chain");
+  lua_pushcfunction(L, find_als_rule);
+  lua_setglobal(L, "find_als");
+  lua_pushcfunction(L, unique_rectangle_rule);
+  lua_setglobal(L, "unique_rectangle");
+  lua_pushcfunction(L, find_unique_rectangle_rule);
+  lua_setglobal(L, "find_unique_rectangle");
+  lua_pushcfunction(L, bug_plus_one_rule);
+  lua_setglobal(L, "bug_plus_one");
+  lua_pushcfunction(L, pattern_overlay_rule);
+  lua_setglobal(L, "pattern_overlay");
+  lua_pushcfunction(L, find_pattern_overlay_rule);
+  lua_setglobal(L, "find_pattern_overlay");
+  lua_pushcfunction(L, nishio_rule);
+  lua_setglobal(L, "nishio");
+  lua_pushcfunction(L, find_nishio_rule);
+  lua_setglobal(L, "find_nishio");
+  lua_pushcfunction(L, count_solutions);
+  lua_setglobal(L, "count_solutions");
+  luaL_newmetatable(L, CELL);
+  luaL_register(L, NULL, cell_methods);
+  lua_pushvalue(L, -1);
+  lua_pushcclosure(L, cell_index, 1);
+  lua_setfield(L, -2, "__index");
+  lua_setglobal(L, "Cell");
   /* Load application written in Lua */
   if (luaL_loadbuffer(L, (const char*)sudoku_lua_bytes,
 		      sizeof(sudoku_lua_bytes), sudoku_lua_source)
@@ -168,3 +1499,13 @@ interp_init(void)
   else
     return NULL;
 }
+
+void
+interp_close(void)
+{
+  if (L)
+    lua_close(L);
+  L = NULL;
+  pool_free(blocks);		/* Returns the chunks to malloc */
+  blocks = NULL;
+}
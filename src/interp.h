@@ -3,6 +3,8 @@
 #ifndef INTERP_H
 #define INTERP_H
 
+#include <stddef.h>
+
 /* Functions this module uses. */
 
 /* Update the val associated with the cell at the given row and col.
@@ -30,6 +32,14 @@ void interp_show(char *text);
 
 char *interp_eval(const char *cmd);
 
+/* Perform a cycle of garbage collection when enough memory has been
+   allocated since the last one.  The interpreter collects garbage
+   when this function is called, or during a command that uses much
+   more memory than was in use after the last cycle.  This function
+   is meant to be called when the program is idle. */
+
+void interp_collect(void);
+
 /* The remaining functions return a non-NULL message on error.  If the
    message is not NULL, the message should be freed after use. */
 
@@ -38,11 +48,29 @@ char *interp_eval(const char *cmd);
 
 char *interp_load(const char *board);
 
-/* Save a board as a string.  Sets board to NULL when no board is
+/* Save a board as a string, in grid form, or in candidate form when
+   candidates is non-zero.  Sets board to NULL when no board is
    loaded.  If the board is not NULL, the board should be freed after
    use.  Returns a non-NULL message on error. */
 
-char *interp_save(char **board);
+char *interp_save(char **board, int candidates);
+
+/* Get the set of digits possible in each of the NCELLS cells of the
+   board.  Returns a non-NULL message on error. */
+
+char *interp_get_vals(int vals[]);
+
+/* Load a board and its history from a binary snapshot of n bytes.
+   Returns a non-NULL message on error. */
+
+char *interp_load_snapshot(const char *data, size_t n);
+
+/* Save the board and its history as a binary snapshot.  Sets data
+   to NULL when no board is loaded, and otherwise to a snapshot of n
+   bytes that should be freed after use.  Returns a non-NULL message
+   on error. */
+
+char *interp_save_snapshot(char **data, size_t *n);
 
 /* Initialize the interpreter.  Returns a non-NULL message on error.
    There is no point in continuing if this function reports an
@@ -50,4 +78,8 @@ char *interp_save(char **board);
 
 char *interp_init(void);
 
+/* Close the interpreter, and return the memory it used. */
+
+void interp_close(void);
+
 #endif
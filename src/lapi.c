@@ -910,6 +910,10 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
       g->GCthreshold = g->totalbytes;
       break;
     }
+    case LUA_GCSETLIMIT: {  /* collect once data Kbytes are in use */
+      g->GCthreshold = cast(lu_mem, data) << 10;
+      break;
+    }
     case LUA_GCCOLLECT: {
       luaC_fullgc(L);
       break;
@@ -948,6 +952,14 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
       g->gcstepmul = data;
       break;
     }
+    case LUA_GCGEN: {
+      luaC_changemode(L, KGC_GEN);
+      break;
+    }
+    case LUA_GCINC: {
+      luaC_changemode(L, KGC_NORMAL);
+      break;
+    }
     default: res = -1;  /* invalid option */
   }
   lua_unlock(L);
@@ -0,0 +1,154 @@
+/*
+** $Id: lbitlib.c $
+** Bitwise operations library
+** See Copyright Notice in lua.h
+*/
+
+
+#include <math.h>
+
+#define lbitlib_c
+#define LUA_LIB
+
+#include "lua.h"
+
+#include "lauxlib.h"
+#include "lualib.h"
+
+
+/* number of bits considered in an operand */
+#define LUA_NBITS	32
+
+#define ALLONES		(~(((~(b_uint)0) << (LUA_NBITS - 1)) << 1))
+
+/* the modulus of the operands, 2^LUA_NBITS */
+#define MODULUS		(2.0 * (lua_Number)((b_uint)1 << (LUA_NBITS - 1)))
+
+
+typedef LUAI_UINT32 b_uint;
+
+
+/*
+** Operands are numbers with an integer value, taken modulo 2^32, so
+** that -1 is all ones.  Results are numbers between 0 and 2^32 - 1,
+** which a double represents exactly.
+*/
+static b_uint checkunsigned (lua_State *L, int narg) {
+  lua_Number n = luaL_checknumber(L, narg);
+  luaL_argcheck(L, floor(n) == n, narg, "number has no integer representation");
+  if (n < 0 || n >= MODULUS) {
+    n = fmod(n, MODULUS);
+    if (n < 0) n += MODULUS;
+  }
+  return (b_uint)n & ALLONES;
+}
+
+
+static int pushunsigned (lua_State *L, b_uint r) {
+  lua_pushnumber(L, (lua_Number)(r & ALLONES));
+  return 1;
+}
+
+
+static int bit_band (lua_State *L) {
+  int i, n = lua_gettop(L);
+  b_uint r = ~(b_uint)0;
+  for (i = 1; i <= n; i++)
+    r &= checkunsigned(L, i);
+  return pushunsigned(L, r);
+}
+
+
+static int bit_bor (lua_State *L) {
+  int i, n = lua_gettop(L);
+  b_uint r = 0;
+  for (i = 1; i <= n; i++)
+    r |= checkunsigned(L, i);
+  return pushunsigned(L, r);
+}
+
+
+static int bit_bxor (lua_State *L) {
+  int i, n = lua_gettop(L);
+  b_uint r = 0;
+  for (i = 1; i <= n; i++)
+    r ^= checkunsigned(L, i);
+  return pushunsigned(L, r);
+}
+
+
+static int bit_bnot (lua_State *L) {
+  return pushunsigned(L, ~checkunsigned(L, 1));
+}
+
+
+/* shift left for positive `i', right for negative `i' */
+static int shift (lua_State *L, b_uint r, int i) {
+  if (i < 0) {
+    i = -i;
+    r &= ALLONES;
+    if (i >= LUA_NBITS) r = 0;
+    else r >>= i;
+  }
+  else {
+    if (i >= LUA_NBITS) r = 0;
+    else r <<= i;
+  }
+  return pushunsigned(L, r);
+}
+
+
+static int bit_lshift (lua_State *L) {
+  return shift(L, checkunsigned(L, 1), luaL_checkint(L, 2));
+}
+
+
+static int bit_rshift (lua_State *L) {
+  return shift(L, checkunsigned(L, 1), -luaL_checkint(L, 2));
+}
+
+
+static int bit_popcount (lua_State *L) {
+  b_uint r = checkunsigned(L, 1);
+  int n = 0;
+  for (; r != 0; r &= r - 1)  /* clear the lowest set bit */
+    n++;
+  lua_pushinteger(L, n);
+  return 1;
+}
+
+
+/* number of trailing zero bits; 32 for zero */
+static int bit_ctz (lua_State *L) {
+  b_uint r = checkunsigned(L, 1);
+  int n = 0;
+  if (r == 0)
+    n = LUA_NBITS;
+  else
+    for (; (r & 1) == 0; r >>= 1)
+      n++;
+  lua_pushinteger(L, n);
+  return 1;
+}
+
+
+static const luaL_Reg bitlib[] = {
+  {"band",     bit_band},
+  {"bnot",     bit_bnot},
+  {"bor",      bit_bor},
+  {"bxor",     bit_bxor},
+  {"ctz",      bit_ctz},
+  {"lshift",   bit_lshift},
+  {"popcount", bit_popcount},
+  {"rshift",   bit_rshift},
+  {NULL, NULL}
+};
+
+
+/*
+** Open bit library
+*/
+LUALIB_API int luaopen_bit (lua_State *L) {
+  luaL_register(L, LUA_BITLIBNAME, bitlib);
+  return 1;
+}
@@ -34,6 +34,10 @@
 #define makewhite(g,x)	\
    ((x)->gch.marked = cast_byte(((x)->gch.marked & maskmarks) | luaC_white(g)))
 
+#define isold(x)	testbit((x)->gch.marked, OLDBIT)
+#define makeold(x)	l_setbit((x)->gch.marked, OLDBIT)
+#define makeyoung(x)	resetbit((x)->gch.marked, OLDBIT)
+
 #define white2gray(x)	reset2bits((x)->gch.marked, WHITE0BIT, WHITE1BIT)
 #define black2gray(x)	resetbit((x)->gch.marked, BLACKBIT)
 
@@ -413,7 +417,8 @@ static GCObject **sweeplist (lua_State *L, GCObject **p, lu_mem count) {
       sweepwholelist(L, &gco2th(curr)->openupval);
     if ((curr->gch.marked ^ WHITEBITS) & deadmask) {  /* not dead? */
       lua_assert(!isdead(g, curr) || testbit(curr->gch.marked, FIXEDBIT));
-      makewhite(g, curr);  /* make it white (for next cycle) */
+      if (!isgenerational(g))  /* generational mode keeps marks */
+        makewhite(g, curr);  /* make it white (for next cycle) */
       p = &curr->gch.next;
     }
     else {  /* must erase `curr' */
@@ -428,6 +433,71 @@ static GCObject **sweeplist (lua_State *L, GCObject **p, lu_mem count) {
 }
 
 
+/*
+** Sweep in generational mode.  New objects are linked at the front of
+** `rootgc' and of the userdata list that follows the main thread, and
+** objects that survive a sweep become old, so every object behind the
+** first old one in either list is old.  Only the young objects in
+** front are swept: dead ones are freed, and marked ones become old.
+** Objects that are still white were created after the mark phase and
+** stay young.  Returns NULL when both lists are done.
+*/
+static GCObject **sweepgen (lua_State *L, GCObject **p, lu_mem count) {
+  GCObject *curr;
+  global_State *g = G(L);
+  int deadmask = otherwhite(g);
+  while ((curr = *p) != NULL && count-- > 0) {
+    if (isold(curr)) {
+      if (curr->gch.tt == LUA_TUSERDATA)
+        return NULL;  /* end of young userdata */
+      p = &g->mainthread->next;  /* end of young part of `rootgc' */
+      continue;
+    }
+    if (curr->gch.tt == LUA_TTHREAD)  /* sweep open upvalues of each thread */
+      sweepwholelist(L, &gco2th(curr)->openupval);
+    if ((curr->gch.marked ^ WHITEBITS) & deadmask) {  /* not dead? */
+      if (!iswhite(curr))
+        makeold(curr);
+      p = &curr->gch.next;
+    }
+    else {  /* must erase `curr' */
+      *p = curr->gch.next;
+      if (curr == g->rootgc)  /* is the first element of the list? */
+        g->rootgc = curr->gch.next;  /* adjust first */
+      freeobj(L, curr);
+    }
+  }
+  return (*p == NULL) ? NULL : p;
+}
+
+
+/*
+** Make every object white and young, as a sweep in normal mode
+** would.  Used when leaving generational mode, after a sweep, so
+** there are no dead objects left to free.
+*/
+static void whitenlist (global_State *g, GCObject *o) {
+  for (; o != NULL; o = o->gch.next) {
+    makewhite(g, o);
+    makeyoung(o);
+    if (o->gch.tt == LUA_TTHREAD)
+      whitenlist(g, gco2th(o)->openupval);
+  }
+}
+
+
+static void whitenall (global_State *g) {
+  int i;
+  lua_assert(g->gcstate == GCSpause || g->gcstate == GCSfinalize);
+  whitenlist(g, g->rootgc);  /* includes the userdata list */
+  for (i = 0; i < g->strt.size; i++)
+    whitenlist(g, g->strt.hash[i]);
+  g->gray = NULL;
+  g->grayagain = NULL;
+  g->weak = NULL;
+}
+
+
 static void checkSizes (lua_State *L) {
   global_State *g = G(L);
   /* check size of string hash */
@@ -455,6 +525,7 @@ static void GCTM (lua_State *L) {
   udata->uv.next = g->mainthread->next;  /* return it to `root' list */
   g->mainthread->next = o;
   makewhite(g, o);
+  makeyoung(o);
   tm = fasttm(L, udata->uv.metatable, TM_GC);
   if (tm != NULL) {
     lu_byte oldah = L->allowhook;
@@ -500,8 +571,23 @@ static void markmt (global_State *g) {
 /* mark root set */
 static void markroot (lua_State *L) {
   global_State *g = G(L);
-  g->gray = NULL;
-  g->grayagain = NULL;
+  if (isgenerational(g)) {
+    /* Old objects stay black, so only the objects gray from the last
+       cycle and from barriers are traversed.  Threads and tables hit
+       by a back barrier are in `grayagain', and weak tables must be
+       traversed again to be cleared. */
+    GCObject *o = g->weak;
+    while (o != NULL) {
+      Table *h = gco2h(o);
+      o = h->gclist;
+      h->gclist = g->gray;
+      g->gray = obj2gco(h);
+    }
+  }
+  else {
+    g->gray = NULL;
+    g->grayagain = NULL;
+  }
   g->weak = NULL;
   markobject(g, g->mainthread);
   /* make global table be traversed before main stack */
@@ -580,8 +666,11 @@ static l_mem singlestep (lua_State *L) {
     }
     case GCSsweep: {
       lu_mem old = g->totalbytes;
-      g->sweepgc = sweeplist(L, g->sweepgc, GCSWEEPMAX);
-      if (*g->sweepgc == NULL) {  /* nothing more to sweep? */
+      if (isgenerational(g))
+        g->sweepgc = sweepgen(L, g->sweepgc, GCSWEEPMAX);
+      else
+        g->sweepgc = sweeplist(L, g->sweepgc, GCSWEEPMAX);
+      if (g->sweepgc == NULL || *g->sweepgc == NULL) {  /* nothing more? */
         checkSizes(L);
         g->gcstate = GCSfinalize;  /* end sweep phase */
       }
@@ -607,9 +696,30 @@ static l_mem singlestep (lua_State *L) {
 }
 
 
+/*
+** In generational mode, each step is a complete minor collection, and
+** when the memory in use has grown enough since the last major
+** collection, the step is a major collection instead.
+*/
+static void stepgen (lua_State *L) {
+  global_State *g = G(L);
+  do
+    singlestep(L);
+  while (g->gcstate != GCSpause);
+  if (g->estimate / LUAI_GCMAJOR > g->lastmajormem / 100)
+    luaC_fullgc(L);
+  else
+    g->GCthreshold = g->totalbytes + (g->estimate / 100) * LUAI_GCMINOR;
+}
+
+
 void luaC_step (lua_State *L) {
   global_State *g = G(L);
   l_mem lim = (GCSTEPSIZE/100) * g->gcstepmul;
+  if (isgenerational(g)) {
+    stepgen(L);
+    return;
+  }
   if (lim == 0)
     lim = (MAX_LUMEM-1)/2;  /* no limit */
   g->gcdept += g->totalbytes - g->GCthreshold;
@@ -634,6 +744,15 @@ void luaC_step (lua_State *L) {
 
 void luaC_fullgc (lua_State *L) {
   global_State *g = G(L);
+  if (isgenerational(g)) {  /* major collection */
+    whitenall(g);  /* every object is young again */
+    markroot(L);
+    while (g->gcstate != GCSpause)
+      singlestep(L);
+    g->lastmajormem = g->estimate;
+    g->GCthreshold = g->totalbytes + (g->estimate / 100) * LUAI_GCMINOR;
+    return;
+  }
   if (g->gcstate <= GCSpropagate) {
     /* reset sweep marks to sweep all elements (returning them to white) */
     g->sweepstrgc = 0;
@@ -661,10 +780,11 @@ void luaC_fullgc (lua_State *L) {
 void luaC_barrierf (lua_State *L, GCObject *o, GCObject *v) {
   global_State *g = G(L);
   lua_assert(isblack(o) && iswhite(v) && !isdead(g, v) && !isdead(g, o));
-  lua_assert(g->gcstate != GCSfinalize && g->gcstate != GCSpause);
+  lua_assert(isgenerational(g) ||
+             (g->gcstate != GCSfinalize && g->gcstate != GCSpause));
   lua_assert(ttype(&o->gch) != LUA_TTABLE);
-  /* must keep invariant? */
-  if (g->gcstate == GCSpropagate)
+  /* must keep invariant? (always, for old objects in generational mode) */
+  if (g->gcstate == GCSpropagate || isgenerational(g))
     reallymarkobject(g, v);  /* restore invariant */
   else  /* don't mind */
     makewhite(g, o);  /* mark as white just to avoid other barriers */
@@ -675,7 +795,8 @@ void luaC_barrierback (lua_State *L, Table *t) {
   global_State *g = G(L);
   GCObject *o = obj2gco(t);
   lua_assert(isblack(o) && !isdead(g, o));
-  lua_assert(g->gcstate != GCSfinalize && g->gcstate != GCSpause);
+  lua_assert(isgenerational(g) ||
+             (g->gcstate != GCSfinalize && g->gcstate != GCSpause));
   black2gray(o);  /* make table gray (again) */
   t->gclist = g->grayagain;
   g->grayagain = o;
@@ -696,8 +817,9 @@ void luaC_linkupval (lua_State *L, UpVal *uv) {
   GCObject *o = obj2gco(uv);
   o->gch.next = g->rootgc;  /* link upvalue into `rootgc' list */
   g->rootgc = o;
+  makeyoung(o);  /* it is at the front of `rootgc' */
   if (isgray(o)) { 
-    if (g->gcstate == GCSpropagate) {
+    if (g->gcstate == GCSpropagate || isgenerational(g)) {
       gray2black(o);  /* closed upvalues need barrier */
       luaC_barrier(L, uv, uv->v);
     }
@@ -708,3 +830,26 @@ void luaC_linkupval (lua_State *L, UpVal *uv) {
   }
 }
 
+
+/*
+** Change the kind of collection.  Generational mode starts from a
+** full collection, after which every object is white, so the first
+** minor collection marks the whole heap and makes the survivors old.
+** Normal mode starts with every object white and young again.
+*/
+void luaC_changemode (lua_State *L, int mode) {
+  global_State *g = G(L);
+  if (mode == g->gckind) return;
+  if (mode == KGC_GEN) {
+    luaC_fullgc(L);
+    g->gray = NULL;  /* lists may hold objects the sweep made white */
+    g->grayagain = NULL;
+    g->weak = NULL;
+    g->gckind = KGC_GEN;
+    g->lastmajormem = g->estimate;
+  }
+  else {
+    whitenall(g);
+    g->gckind = KGC_NORMAL;
+  }
+}
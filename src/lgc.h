@@ -21,6 +21,15 @@
 #define GCSfinalize	4
 
 
+/*
+** Kinds of collection
+*/
+#define KGC_NORMAL	0
+#define KGC_GEN		1  /* generational mode: minor collections */
+
+#define isgenerational(g)	((g)->gckind == KGC_GEN)
+
+
 /*
 ** some userful bit tricks
 */
@@ -48,6 +57,7 @@
 ** bit 4 - for tables: has weak values
 ** bit 5 - object is fixed (should not be collected)
 ** bit 6 - object is "super" fixed (only the main thread)
+** bit 7 - object is old (generational mode)
 */
 
 
@@ -59,6 +69,7 @@
 #define VALUEWEAKBIT	4
 #define FIXEDBIT	5
 #define SFIXEDBIT	6
+#define OLDBIT		7
 #define WHITEBITS	bit2mask(WHITE0BIT, WHITE1BIT)
 
 
@@ -105,6 +116,7 @@ LUAI_FUNC void luaC_link (lua_State *L, GCObject *o, lu_byte tt);
 LUAI_FUNC void luaC_linkupval (lua_State *L, UpVal *uv);
 LUAI_FUNC void luaC_barrierf (lua_State *L, GCObject *o, GCObject *v);
 LUAI_FUNC void luaC_barrierback (lua_State *L, Table *t);
+LUAI_FUNC void luaC_changemode (lua_State *L, int mode);
 
 
 #endif
@@ -226,6 +226,9 @@ LUA_API int  (lua_status) (lua_State *L);
 #define LUA_GCSTEP		5
 #define LUA_GCSETPAUSE		6
 #define LUA_GCSETSTEPMUL	7
+#define LUA_GCGEN		8
+#define LUA_GCINC		9
+#define LUA_GCSETLIMIT		10
 
 LUA_API int (lua_gc) (lua_State *L, int what, int data);
 
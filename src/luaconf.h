@@ -313,6 +313,19 @@
 #define LUAI_GCMUL	200 /* GC runs 'twice the speed' of memory allocation */
 
 
+/*
+@@ LUAI_GCMINOR defines, in generational mode, how much memory may be
+@* allocated between minor collections, as a percentage of the memory
+@* in use after the previous collection.
+@@ LUAI_GCMAJOR defines, in generational mode, how much the memory in
+@* use may grow after a major collection, as a percentage of its size
+@* then, before the next collection is a major one.
+** CHANGE them if you want different generational behavior.
+*/
+#define LUAI_GCMINOR	20  /* minor after allocating 20% of memory in use */
+#define LUAI_GCMAJOR	200 /* major when memory in use doubles */
+
+
 
 /*
 @@ LUA_COMPAT_GETN controls compatibility with old getn behavior.
@@ -382,6 +395,18 @@
 #endif
 
 
+/*
+@@ LUA_USE_JUMPTABLE makes the interpreter dispatch instructions
+@* through a table of label addresses instead of a switch.
+** CHANGE it (define it) if your compiler supports labels as values
+** (GCC and Clang do). Each instruction then jumps directly to the
+** code of the next one. Measured on the solver, it is no faster than
+** the switch, so it is off unless configure is given
+** --enable-threaded-dispatch.
+*/
+/* #define LUA_USE_JUMPTABLE */
+
+
 /*
 @@ LUAI_BITSINT defines the number of bits in an int.
 ** CHANGE here if Lua cannot automatically detect the number of bits of
@@ -0,0 +1,148 @@
+/*
+ * A size class allocator for the Lua interpreter.
+ *
+ * Copyright (C) 2006 John D. Ramsdell
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/*
+ * Small blocks are carved out of large chunks obtained from malloc,
+ * and are sorted into size classes that are a multiple of GRANULE
+ * bytes.  Each size class has its own free list, so a freed block is
+ * reused by the next request in the same class without going back to
+ * malloc.  Lua passes the old size of a block to its allocator, so
+ * the class of a block is always known, and blocks carry no header.
+ * Blocks larger than the largest class are handed to malloc.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "pool.h"
+
+/* Size classes are multiples of this many bytes. */
+#define GRANULE 8
+/* The largest block served from a size class. */
+#define MAX_SMALL 256
+/* Number of size classes. */
+#define NCLASSES (MAX_SMALL / GRANULE)
+/* Size of a chunk obtained from malloc. */
+#define CHUNK_SIZE (64 * 1024)
+
+struct block {
+  struct block *next;
+};
+
+struct chunk {
+  struct chunk *next;
+  double align;			/* Blocks start after this */
+};
+
+struct pool {
+  struct block *free[NCLASSES];	/* Free lists */
+  char *next;			/* Unused part of the current chunk */
+  char *end;
+  struct chunk *chunks;		/* All chunks obtained from malloc */
+};
+
+/* The size class of a block of size n, where 0 < n <= MAX_SMALL. */
+static int
+size_class(size_t n)
+{
+  return (n - 1) / GRANULE;
+}
+
+pool *
+pool_new(void)
+{
+  return calloc(1, sizeof(pool));
+}
+
+void
+pool_free(pool *p)
+{
+  if (!p)
+    return;
+  struct chunk *c = p->chunks;
+  while (c) {
+    struct chunk *next = c->next;
+    free(c);
+    c = next;
+  }
+  free(p);
+}
+
+static void *
+small_alloc(pool *p, int class)
+{
+  struct block *b = p->free[class];
+  if (b) {
+    p->free[class] = b->next;
+    return b;
+  }
+  size_t n = (class + 1) * GRANULE;
+  if (!p->next || n > (size_t)(p->end - p->next)) { /* Get a new chunk */
+    struct chunk *c = malloc(CHUNK_SIZE);
+    if (!c)
+      return NULL;
+    c->next = p->chunks;
+    p->chunks = c;
+    p->next = (char *)&c->align;
+    p->end = (char *)c + CHUNK_SIZE;
+  }
+  void *ptr = p->next;
+  p->next += n;
+  return ptr;
+}
+
+static void
+small_free(pool *p, void *ptr, int class)
+{
+  struct block *b = ptr;
+  b->next = p->free[class];
+  p->free[class] = b;
+}
+
+void *
+pool_alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+  pool *p = ud;
+  if (nsize == 0) {		/* Free */
+    if (ptr && osize <= MAX_SMALL)
+      small_free(p, ptr, size_class(osize));
+    else
+      free(ptr);
+    return NULL;
+  }
+  if (!ptr || osize == 0) {	/* Allocate */
+    if (nsize <= MAX_SMALL)
+      return small_alloc(p, size_class(nsize));
+    else
+      return malloc(nsize);
+  }
+  if (osize > MAX_SMALL && nsize > MAX_SMALL) /* Reallocate */
+    return realloc(ptr, nsize);
+  if (osize <= MAX_SMALL && nsize <= MAX_SMALL
+      && size_class(osize) == size_class(nsize))
+    return ptr;
+  void *new = pool_alloc(p, NULL, 0, nsize);
+  if (!new)
+    return NULL;
+  memcpy(new, ptr, osize < nsize ? osize : nsize);
+  pool_alloc(p, ptr, osize, 0);
+  return new;
+}
@@ -0,0 +1,22 @@
+/* A size class allocator for the Lua interpreter. */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+typedef struct pool pool;
+
+/* Create an empty pool.  Returns NULL when out of memory. */
+pool *pool_new(void);
+
+/* Release a pool and every block allocated from it. */
+void pool_free(pool *p);
+
+/* An allocator with the signature of lua_Alloc.  The ud parameter is
+   the pool.  A pool has no locks, so it must be used by only one
+   thread at a time, which is the case for the blocks of a Lua
+   state. */
+void *pool_alloc(void *ud, void *ptr, size_t osize, size_t nsize);
+
+#endif
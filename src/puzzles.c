@@ -0,0 +1,294 @@
+/*
+ * Collections of puzzles read from a file, one puzzle per line.
+ *
+ * Copyright (C) 2006 John D. Ramsdell
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/*
+ * A file of puzzles is mapped into memory rather than read, so that
+ * opening a large file costs little.  A packed corpus has an index of
+ * its own.  For a file of text, the offset of each puzzle is recorded
+ * in an index that is built only as far as the puzzles asked for, so
+ * going to the next puzzle scans just one line.  Once the whole file
+ * has been scanned, the index is saved next to the file, and is
+ * mapped in place of scanning the next time the file is opened, as
+ * long as the file has not changed since.
+ */
+
+#include <string.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include "config.h"
+#include "gtksudoku.h"
+#include "board.h"
+#include "corpus.h"
+#include "puzzles.h"
+
+/* The header of a saved index.  The file size and modification time
+   identify the version of the file indexed.  The offsets of the
+   puzzles follow the header, in native byte order. */
+typedef struct {
+  char magic[4];
+  guint32 order;		/* Detects a change of byte order */
+  guint64 size;
+  gint64 mtime;
+  guint64 count;
+} index_header;
+
+static const char magic[] = {'G', 'S', 'I', '1'};
+#define ORDER 0x01020304
+
+/* Files with fewer puzzles are scanned about as fast as an index is
+   read, so their index is not saved. */
+#define INDEX_MIN 1000
+
+static struct {
+  gboolean open;
+  GMappedFile *map;		/* The file when it is mapped, */
+  gchar *inflated;		/* or when it is decompressed. */
+  const char *data;
+  size_t size;
+  gchar *index_name;
+  index_header stamp;		/* The header of this file's index */
+  GMappedFile *index;		/* A saved index, */
+  const guint64 *offsets;	/* and its offsets. */
+  GArray *lines;		/* The index built so far, */
+  size_t scanned;		/* and where scanning resumes. */
+  int packed;			/* Puzzles in a packed corpus */
+  char line[NCELLS];		/* The puzzle unpacked last */
+} c;
+
+void
+puzzles_close(void)
+{
+  if (c.map)
+    g_mapped_file_unref(c.map);
+  g_free(c.inflated);
+  g_free(c.index_name);
+  if (c.index)
+    g_mapped_file_unref(c.index);
+  if (c.lines)
+    g_array_free(c.lines, TRUE);
+  memset(&c, 0, sizeof c);
+}
+
+/* Decompress a gzip file into memory.  Returns NULL on error. */
+
+static gchar *
+gunzip(const char *file_name, size_t *size)
+{
+  GFile *file = g_file_new_for_path(file_name);
+  GFileInputStream *in = g_file_read(file, NULL, NULL);
+  g_object_unref(file);
+  if (!in)
+    return NULL;
+  GConverter *gz =
+    G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+  GInputStream *text = g_converter_input_stream_new(G_INPUT_STREAM(in), gz);
+  g_object_unref(gz);
+  g_object_unref(in);
+  GOutputStream *out = g_memory_output_stream_new(NULL, 0, g_realloc, g_free);
+  gssize n = g_output_stream_splice(out, text,
+				    G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE
+				    | G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+				    NULL, NULL);
+  g_object_unref(text);
+  gchar *data = NULL;
+  if (n >= 0) {
+    GMemoryOutputStream *mem = G_MEMORY_OUTPUT_STREAM(out);
+    *size = g_memory_output_stream_get_data_size(mem);
+    data = g_memory_output_stream_steal_data(mem);
+  }
+  g_object_unref(out);
+  return data;
+}
+
+/* Map the saved index when it belongs to this version of the
+   file. */
+
+static void
+load_index(void)
+{
+  GMappedFile *map = g_mapped_file_new(c.index_name, FALSE, NULL);
+  if (!map)
+    return;
+  size_t n = g_mapped_file_get_length(map);
+  const index_header *h =
+    (const index_header *)g_mapped_file_get_contents(map);
+  if (n < sizeof *h
+      || memcmp(h->magic, magic, sizeof magic)
+      || h->order != ORDER
+      || h->size != c.stamp.size
+      || h->mtime != c.stamp.mtime
+      || (n - sizeof *h) / sizeof(guint64) != h->count
+      || (n - sizeof *h) % sizeof(guint64)) {
+    g_mapped_file_unref(map);
+    return;
+  }
+  c.index = map;
+  c.stamp.count = h->count;
+  c.offsets = (const guint64 *)(h + 1);
+}
+
+/* Save the index once it is complete.  Failure to save it is not an
+   error, as the index is rebuilt when missing. */
+
+static void
+save_index(void)
+{
+  c.stamp.count = c.lines->len;
+  size_t n = sizeof c.stamp + c.lines->len * sizeof(guint64);
+  char *buf = g_malloc(n);
+  memcpy(buf, &c.stamp, sizeof c.stamp);
+  memcpy(buf + sizeof c.stamp, c.lines->data, n - sizeof c.stamp);
+  g_file_set_contents(c.index_name, buf, n, NULL);
+  g_free(buf);
+}
+
+/* Is the line starting at offset i blank or a comment? */
+
+static gboolean
+skip_line(size_t i)
+{
+  int ch = c.data[i];
+  return ch == '\n' || ch == '\r' || ch == '#';
+}
+
+/* Extend the index until it holds n puzzles, or the whole file has
+   been scanned.  Returns true if the index holds n puzzles. */
+
+static gboolean
+index_to(int n)
+{
+  while (c.lines->len < (guint)n && c.scanned < c.size) {
+    size_t start = c.scanned;
+    const char *end = memchr(c.data + start, '\n', c.size - start);
+    c.scanned = end ? end - c.data + 1 : c.size;
+    if (!skip_line(start)) {
+      guint64 offset = start;
+      g_array_append_val(c.lines, offset);
+    }
+    if (c.scanned == c.size && c.lines->len >= INDEX_MIN)
+      save_index();
+  }
+  return c.lines->len >= (guint)n;
+}
+
+const char *
+puzzles_get(int n, size_t *len)
+{
+  if (!c.open || n < 1)
+    return NULL;
+  if (c.packed) {
+    if (!corpus_get((const unsigned char *)c.data, c.size, n - 1, c.line))
+      return NULL;
+    *len = NCELLS;
+    return c.line;
+  }
+  size_t start;
+  if (c.offsets) {
+    if ((guint64)n > c.stamp.count)
+      return NULL;
+    start = c.offsets[n - 1];
+    if (start >= c.size)	/* Guard against a stale index */
+      return NULL;
+  }
+  else {
+    if (!index_to(n))
+      return NULL;
+    start = g_array_index(c.lines, guint64, n - 1);
+  }
+  const char *s = c.data + start;
+  const char *end = memchr(s, '\n', c.size - start);
+  *len = end ? end - s : c.size - start;
+  return s;
+}
+
+int
+puzzles_count(void)
+{
+  if (!c.open)
+    return 0;
+  if (c.packed)
+    return c.packed;
+  if (c.offsets)
+    return c.stamp.count;
+  index_to(G_MAXINT);
+  return c.lines->len;
+}
+
+const char *
+puzzles_open(const char *file_name)
+{
+  puzzles_close();
+  GStatBuf st;
+  if (g_stat(file_name, &st))
+    return "failed to open file";
+  if (g_str_has_suffix(file_name, ".gz")) {
+    c.inflated = gunzip(file_name, &c.size);
+    if (!c.inflated)
+      return "failed to read file";
+    c.data = c.inflated;
+  }
+  else {
+    c.map = g_mapped_file_new(file_name, FALSE, NULL);
+    if (!c.map)
+      return "failed to open file";
+    c.data = g_mapped_file_get_contents(c.map);
+    c.size = g_mapped_file_get_length(c.map);
+  }
+  if (g_str_has_suffix(file_name, CORPUS_EXT)) {
+    const char *msg = corpus_open((const unsigned char *)c.data, c.size,
+				  &c.packed);
+    if (msg || !c.packed) {
+      puzzles_close();
+      return msg ? msg : "corpus is empty";
+    }
+    c.open = TRUE;
+    return NULL;
+  }
+  memcpy(c.stamp.magic, magic, sizeof magic);
+  c.stamp.order = ORDER;
+  c.stamp.size = st.st_size;
+  c.stamp.mtime = st.st_mtime;
+  c.index_name = g_strconcat(file_name, PUZZLES_INDEX_EXT, NULL);
+  load_index();
+  if (!c.offsets)
+    c.lines = g_array_new(FALSE, FALSE, sizeof(guint64));
+  c.open = TRUE;
+
+  /* The first puzzle must be a board and nothing else, but for
+     white space around it, so that a board written with its possible
+     digits, whose first row alone holds 81 digits, is not taken for
+     a file of puzzles. */
+  size_t len, n = 0;
+  const char *s = puzzles_get(1, &len);
+  if (s) {
+    for (; len > 0 && g_ascii_isspace(*s); len--)
+      s++;
+    for (; len > 0 && g_ascii_isspace(s[len - 1]); len--)
+      ;
+    for (; n < len && isboardchar(s[n]); n++)
+      ;
+  }
+  if (n != NCELLS || len != NCELLS) {
+    puzzles_close();
+    return "not a file of puzzles";
+  }
+  return NULL;
+}
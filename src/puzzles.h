@@ -0,0 +1,31 @@
+/* Collections of puzzles read from a file, one puzzle per line. */
+
+#ifndef PUZZLES_H
+#define PUZZLES_H
+
+#include <stddef.h>
+
+/* The extension of the index kept next to a file of puzzles. */
+#define PUZZLES_INDEX_EXT ".idx"
+
+/* Opens a file of puzzles as the collection, replacing the previous
+   one.  The file is mapped into memory, or decompressed into memory
+   when its name ends in .gz.  A file with the corpus extension holds
+   a packed corpus.  Otherwise, the first line that is not blank must
+   hold a whole board, one character per cell, and nothing else.
+   Returns a non-NULL message on error, in which
+   case there is no collection. */
+const char *puzzles_open(const char *file_name);
+
+/* Closes the collection, if any. */
+void puzzles_close(void);
+
+/* Returns the text of puzzle n, counting from one, and sets len to
+   its length.  The text is not null terminated.  Returns NULL when
+   there is no such puzzle. */
+const char *puzzles_get(int n, size_t *len);
+
+/* Returns the number of puzzles in the collection. */
+int puzzles_count(void);
+
+#endif
@@ -0,0 +1,1595 @@
+/*
+ * Rules that work on a board as an array of digit sets.
+ *
+ * Copyright (C) 2006 John D. Ramsdell
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/*
+ * Rules about subsets look at a house through its position masks.
+ * The position mask of digit d in a house has bit k set when d is
+ * possible in the undetermined cell at position k of the house.  A
+ * set of digits has as many places as bits in the union of their
+ * position masks, and the cells holding nothing but digits of the set
+ * are the places of the set less the places of the other digits, so
+ * each subset is checked with a handful of bitwise operations.
+ *
+ * Fish look at a digit through the masks of its places in each row
+ * or column.  The lines of a base cover as many crossing lines as
+ * there are bits in the union of their masks.
+ *
+ * Wings start from an index of the cells with two possible digits,
+ * and cells that see each other are found by intersecting sets of
+ * peers, so only cells that might be part of a wing are visited.
+ * The index is rebuilt on each call.  Every change to a cell goes
+ * through a few functions in interp.c, but a cell has no pointer
+ * back to its board, so there is no board to keep an index for, and
+ * a rebuild takes well under a microsecond.
+ *
+ * Chains work on a graph whose nodes are candidates, a digit possible
+ * in an undetermined cell.  Two candidates are strongly linked when
+ * one of them must be true, and weakly linked when they cannot both
+ * be true.  The links of each candidate are kept in adjacency arrays
+ * built in one pass over the board, for each search, for the reason
+ * the index of wings is.  A rebuild takes about 23 microseconds, and
+ * an all that finds nothing does eleven of them.
+ *
+ * An almost locked set is n cells in a house with n + 1 digits
+ * possible among them.  Rules about them start from a catalogue of
+ * every such set, found by trying each subset of the undetermined
+ * cells in each house, with each kept as a set of cells and a set of
+ * digits.
+ *
+ * Rules that assume the puzzle has a unique solution avoid patterns
+ * that would allow two.  Unique rectangles are found by scanning the
+ * rectangles with a corner in the index of cells with two digits.
+ *
+ * The pattern overlay method works on templates, the sets of nine
+ * cells, one in each row, column, and square, in which a digit could
+ * be placed.  Every digit has the same 46,656 templates.  They are
+ * built on first use, which is quicker than reading them from a
+ * compressed table, and kept as two arrays of words, so that a digit
+ * is checked against them with a few bitwise operations each, two at
+ * a time where SSE2 is available.  Templates whose cell in the first
+ * row cannot hold the digit are skipped in blocks.
+ *
+ * Nishio tries a candidate by placing it and determining singles
+ * until the board is stuck or a contradiction is reached.  A trial
+ * changes the board in place, and saves each cell it changes in an
+ * undo log the first time, so undoing a trial costs no more than
+ * making it, and every candidate on the board can be tried quickly.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "gtksudoku.h"
+#include "board.h"
+#include "rules.h"
+
+#if defined __SSE2__
+#include <emmintrin.h>
+#endif
+
+int house_cells[NHOUSES][DIGITS];
+
+/* The sets of n digits, for n up to MAX_SUBSET. */
+#define MAX_SUBSET 4
+static int subsets[MAX_SUBSET + 1][126];
+static int nsubsets[MAX_SUBSET + 1];
+
+static int
+popcount(int x)
+{
+  int n = 0;
+  for (; x; x &= x - 1)
+    n++;
+  return n;
+}
+
+/* A set of cells, with cell i as bit i % 64 of word i / 64. */
+typedef struct {
+  uint64_t w[2];
+} cellset;
+
+static cellset peers[NCELLS];	/* The other cells in a cell's houses */
+static int houses_of[NCELLS][3]; /* The square, row, and column */
+
+static int
+has_cell(const cellset *s, int i)
+{
+  return s->w[i >> 6] >> (i & 63) & 1;
+}
+
+static void
+add_cell(cellset *s, int i)
+{
+  s->w[i >> 6] |= UINT64_C(1) << (i & 63);
+}
+
+static cellset
+intersect(cellset a, cellset b)
+{
+  a.w[0] &= b.w[0];
+  a.w[1] &= b.w[1];
+  return a;
+}
+
+/* The least cell in s that is not less than i, or NCELLS when there
+   is none. */
+
+static int
+next_cell(const cellset *s, int i)
+{
+  while (i < NCELLS) {
+    uint64_t w = s->w[i >> 6] >> (i & 63);
+    if (w) {
+      for (; !(w & 1); w >>= 1)
+	i++;
+      return i;
+    }
+    i = (i | 63) + 1;
+  }
+  return NCELLS;
+}
+
+/* The digits possible in a cell not yet determined, else none. */
+
+static int
+open_digits(const grid *g, int i)
+{
+  return g->determined[i] ? 0 : g->vals[i];
+}
+
+/* Eliminate the digits in mask from the undetermined cells in s. */
+
+static int
+eliminate(grid *g, int mask, const cellset *s)
+{
+  int i, e = 0;
+  for (i = next_cell(s, 0); i < NCELLS; i = next_cell(s, i + 1))
+    if (open_digits(g, i) & mask) {
+      g->vals[i] &= ~mask;
+      e = 1;
+    }
+  return e;
+}
+
+void
+rules_init(void)
+{
+  int i, set;
+  for (i = 0; i < NCELLS; i++) {
+    int row = i / DIGITS, col = i % DIGITS;
+    int square = row / SIDES * SIDES + col / SIDES;
+    int pos = row % SIDES * SIDES + col % SIDES;
+    house_cells[square][pos] = i;
+    house_cells[DIGITS + row][col] = i;
+    house_cells[2 * DIGITS + col][row] = i;
+    houses_of[i][0] = square;
+    houses_of[i][1] = DIGITS + row;
+    houses_of[i][2] = 2 * DIGITS + col;
+  }
+  for (i = 0; i < NHOUSES * DIGITS; i++) {
+    int h = i / DIGITS, j = house_cells[h][i % DIGITS], k;
+    for (k = 0; k < DIGITS; k++)
+      if (house_cells[h][k] != j)
+	add_cell(&peers[j], house_cells[h][k]);
+  }
+  for (set = 1; set <= ALL; set++) {
+    int n = popcount(set);
+    if (n <= MAX_SUBSET)
+      subsets[n][nsubsets[n]++] = set;
+  }
+}
+
+/* Compute the position masks of each digit in house h. */
+
+static void
+positions(const grid *g, int h, int pos[DIGITS])
+{
+  int d, k;
+  for (d = 0; d < DIGITS; d++)
+    pos[d] = 0;
+  for (k = 0; k < DIGITS; k++) {
+    int i = house_cells[h][k];
+    if (!g->determined[i])
+      for (d = 0; d < DIGITS; d++)
+	if (g->vals[i] & 1 << d)
+	  pos[d] |= 1 << k;
+  }
+}
+
+/* The union of the position masks of the digits in set. */
+
+static int
+places(const int pos[DIGITS], int set)
+{
+  int d, m = 0;
+  for (d = 0; d < DIGITS; d++)
+    if (set & 1 << d)
+      m |= pos[d];
+  return m;
+}
+
+/* The cells of a naked subset, when the set is one, and the cells
+   from which its digits would be eliminated. */
+
+static int
+naked_cells(const int pos[DIGITS], int set, int *others)
+{
+  int inside = places(pos, set);
+  int cells = inside & ~places(pos, ALL & ~set);
+  if (popcount(cells) != popcount(set))
+    return 0;
+  *others = inside & ~cells;
+  return cells;
+}
+
+/* The cells of a hidden subset, when the set is one.  Sets extra to
+   the cells with other digits to eliminate. */
+
+static int
+hidden_cells(const int pos[DIGITS], int set, int *extra)
+{
+  int d;
+  for (d = 0; d < DIGITS; d++)
+    if (set & 1 << d && !pos[d])
+      return 0;			/* Digit placed or impossible */
+  int cells = places(pos, set);
+  if (popcount(cells) != popcount(set))
+    return 0;
+  *extra = cells & places(pos, ALL & ~set);
+  return cells;
+}
+
+/* Apply a mask to the digits of the cells of house h in where. */
+
+static int
+restrict_cells(grid *g, int h, int where, int mask)
+{
+  int k, e = 0;
+  for (k = 0; k < DIGITS; k++)
+    if (where & 1 << k) {
+      int i = house_cells[h][k];
+      if (g->vals[i] & ~mask) {
+	g->vals[i] &= mask;
+	e = 1;
+      }
+    }
+  return e;
+}
+
+int
+naked_subset(grid *g, int h, int set)
+{
+  int pos[DIGITS], others;
+  positions(g, h, pos);
+  if (!naked_cells(pos, set, &others))
+    return 0;
+  return restrict_cells(g, h, others, ALL & ~set);
+}
+
+int
+hidden_subset(grid *g, int h, int set)
+{
+  int pos[DIGITS], extra;
+  positions(g, h, pos);
+  if (!hidden_cells(pos, set, &extra))
+    return 0;
+  return restrict_cells(g, h, extra, set);
+}
+
+int
+find_subset(grid *g, int n, int *h, int *set)
+{
+  if (n < 1 || n > MAX_SUBSET)
+    return 0;
+  int j, k;
+  for (j = 0; j < NHOUSES; j++) {
+    int pos[DIGITS];
+    positions(g, j, pos);
+    for (k = 0; k < nsubsets[n]; k++) {
+      int s = subsets[n][k], where;
+      if (naked_cells(pos, s, &where) && where) {
+	restrict_cells(g, j, where, ALL & ~s);
+	*h = j;
+	*set = s;
+	return NAKED_SUBSET;
+      }
+      if (hidden_cells(pos, s, &where) && where) {
+	restrict_cells(g, j, where, s);
+	*h = j;
+	*set = s;
+	return HIDDEN_SUBSET;
+      }
+    }
+  }
+  return 0;
+}
+
+/* Compute the masks of the places of digit d in each line, where a
+   line is a row or column as given by kind. */
+
+static void
+line_masks(const grid *g, int d, int kind, int mask[DIGITS])
+{
+  int bit = 1 << (d - 1);
+  int l, x;
+  for (l = 0; l < DIGITS; l++) {
+    mask[l] = 0;
+    for (x = 0; x < DIGITS; x++) {
+      int i = kind == ROW_FISH ? l * DIGITS + x : x * DIGITS + l;
+      if (!g->determined[i] && g->vals[i] & bit)
+	mask[l] |= 1 << x;
+    }
+  }
+}
+
+/* Eliminate digit d from the crossing lines in cover of the lines
+   not in base, but only in lines in keep, at crossings in cross. */
+
+static int
+eliminate_fish(grid *g, int d, int kind, int base, int cover,
+	       int keep, int cross)
+{
+  int bit = 1 << (d - 1);
+  int l, x, e = 0;
+  for (l = 0; l < DIGITS; l++)
+    if (!(base & 1 << l) && keep & 1 << l)
+      for (x = 0; x < DIGITS; x++)
+	if (cover & cross & 1 << x) {
+	  int i = kind == ROW_FISH ? l * DIGITS + x : x * DIGITS + l;
+	  if (!g->determined[i] && g->vals[i] & bit) {
+	    g->vals[i] &= ~bit;
+	    e = 1;
+	  }
+	}
+  return e;
+}
+
+/* The mask of the lines in the band or stack of three that holds the
+   lines in m, or zero when they are in more than one. */
+
+static int
+band(int m)
+{
+  int b;
+  for (b = 0; b < SIDES; b++) {
+    int lines = ((1 << SIDES) - 1) << b * SIDES;
+    if (!(m & ~lines))
+      return lines;
+  }
+  return 0;
+}
+
+/* Apply a fish given the masks of its digit. */
+
+static int
+fish_masks(grid *g, int d, int kind, const int mask[DIGITS],
+	   int base, int finned)
+{
+  int n = popcount(base);
+  int l, k, all = 0;
+  if (n < 2 || n > MAX_SUBSET)
+    return 0;
+  for (l = 0; l < DIGITS; l++)
+    if (base & 1 << l) {
+      if (!mask[l])
+	return 0;		/* Digit placed in line */
+      all |= mask[l];
+    }
+  if (popcount(all) == n)
+    return eliminate_fish(g, d, kind, base, all, ALL, ALL);
+  if (!finned)
+    return 0;
+  /* Try each set of n crossing lines as a cover.  The places outside
+     the cover are the fins. */
+  for (k = 0; k < nsubsets[n]; k++) {
+    int cover = subsets[n][k];
+    if (cover & ~all)
+      continue;
+    int fin_lines = 0, fin_crosses = 0;
+    for (l = 0; l < DIGITS; l++)
+      if (base & 1 << l && mask[l] & ~cover) {
+	fin_lines |= 1 << l;
+	fin_crosses |= mask[l] & ~cover;
+      }
+    int keep = band(fin_lines), cross = band(fin_crosses);
+    if (fin_lines && keep && cross
+	&& eliminate_fish(g, d, kind, base, cover, keep, cross))
+      return 1;
+  }
+  return 0;
+}
+
+int
+fish(grid *g, int d, int kind, int base, int finned)
+{
+  int mask[DIGITS];
+  line_masks(g, d, kind, mask);
+  return fish_masks(g, d, kind, mask, base, finned);
+}
+
+int
+find_fish(grid *g, int n, int finned, int *d, int *base)
+{
+  if (n < 2 || n > MAX_SUBSET)
+    return 0;
+  int kind, k;
+  for (*d = 1; *d <= DIGITS; (*d)++)
+    for (kind = ROW_FISH; kind <= COLUMN_FISH; kind++) {
+      int mask[DIGITS];
+      line_masks(g, *d, kind, mask);
+      for (k = 0; k < nsubsets[n]; k++) {
+	*base = subsets[n][k];
+	if (fish_masks(g, *d, kind, mask, *base, finned))
+	  return kind;
+      }
+    }
+  return 0;
+}
+
+/* The index of cells with two possible digits. */
+
+typedef struct {
+  int n;
+  int cells[NCELLS];
+  cellset set;
+} bivalues;
+
+static void
+index_bivalues(const grid *g, bivalues *b)
+{
+  int i;
+  b->n = 0;
+  b->set.w[0] = b->set.w[1] = 0;
+  for (i = 0; i < NCELLS; i++)
+    if (popcount(open_digits(g, i)) == 2) {
+      b->cells[b->n++] = i;
+      add_cell(&b->set, i);
+    }
+}
+
+static int
+valid_cells(int p, int a, int b)
+{
+  return 0 <= p && p < NCELLS && 0 <= a && a < NCELLS
+    && 0 <= b && b < NCELLS;
+}
+
+int
+xy_wing(grid *g, int p, int a, int b)
+{
+  if (!valid_cells(p, a, b)
+      || !has_cell(&peers[p], a) || !has_cell(&peers[p], b))
+    return 0;
+  int mp = open_digits(g, p), ma = open_digits(g, a);
+  int mb = open_digits(g, b);
+  if (popcount(mp) != 2 || popcount(ma) != 2 || popcount(mb) != 2
+      || ma == mp || mb == mp || ma == mb
+      || popcount(mp | ma | mb) != 3)
+    return 0;
+  int z = ma & mb & ~mp;
+  cellset s = intersect(peers[a], peers[b]);
+  return eliminate(g, z, &s);
+}
+
+int
+xyz_wing(grid *g, int p, int a, int b)
+{
+  if (!valid_cells(p, a, b)
+      || !has_cell(&peers[p], a) || !has_cell(&peers[p], b))
+    return 0;
+  int mp = open_digits(g, p), ma = open_digits(g, a);
+  int mb = open_digits(g, b);
+  if (popcount(mp) != 3 || popcount(ma) != 2 || popcount(mb) != 2
+      || ma == mb || (ma | mb) != mp)
+    return 0;
+  int z = ma & mb;
+  cellset s = intersect(peers[p], intersect(peers[a], peers[b]));
+  return eliminate(g, z, &s);
+}
+
+/* Is there a house in which digit d has just two places, one seen by
+   cell a and the other by cell b? */
+
+static int
+strong_link(const grid *g, int d, int a, int b)
+{
+  int bit = 1 << (d - 1);
+  int h, k;
+  for (h = 0; h < NHOUSES; h++) {
+    int ends[2], n = 0;
+    for (k = 0; k < DIGITS && n <= 2; k++) {
+      int i = house_cells[h][k];
+      if (open_digits(g, i) & bit) {
+	if (n < 2)
+	  ends[n] = i;
+	n++;
+      }
+    }
+    if (n != 2 || ends[0] == a || ends[0] == b
+	|| ends[1] == a || ends[1] == b)
+      continue;
+    if ((has_cell(&peers[a], ends[0]) && has_cell(&peers[b], ends[1]))
+	|| (has_cell(&peers[a], ends[1]) && has_cell(&peers[b], ends[0])))
+      return 1;
+  }
+  return 0;
+}
+
+int
+w_wing(grid *g, int d, int a, int b)
+{
+  if (d < 1 || d > DIGITS || !valid_cells(a, a, b)
+      || a == b || has_cell(&peers[a], b))
+    return 0;
+  int m = open_digits(g, a);
+  if (popcount(m) != 2 || m != open_digits(g, b)
+      || !(m & 1 << (d - 1)) || !strong_link(g, d, a, b))
+    return 0;
+  cellset s = intersect(peers[a], peers[b]);
+  return eliminate(g, m & ~(1 << (d - 1)), &s);
+}
+
+/* The least digit in a mask. */
+
+static int
+first_digit(int m)
+{
+  int d;
+  for (d = 1; !(m & 1 << (d - 1)); d++);
+  return d;
+}
+
+int
+find_wing(grid *g, int kind, int cells[3], int *d)
+{
+  bivalues bv;
+  index_bivalues(g, &bv);
+  int j, k, a, b;
+  switch (kind) {
+  case XY_WING:
+    for (j = 0; j < bv.n; j++) {
+      int p = bv.cells[j];
+      cellset pincers = intersect(bv.set, peers[p]);
+      for (a = next_cell(&pincers, 0); a < NCELLS;
+	   a = next_cell(&pincers, a + 1))
+	for (b = next_cell(&pincers, a + 1); b < NCELLS;
+	     b = next_cell(&pincers, b + 1)) {
+	  int z = open_digits(g, a) & open_digits(g, b);
+	  if (xy_wing(g, p, a, b)) {
+	    cells[0] = p;
+	    cells[1] = a;
+	    cells[2] = b;
+	    *d = first_digit(z);
+	    return kind;
+	  }
+	}
+    }
+    break;
+  case XYZ_WING:
+    for (j = 0; j < NCELLS; j++) {
+      if (popcount(open_digits(g, j)) != 3)
+	continue;
+      cellset pincers = intersect(bv.set, peers[j]);
+      for (a = next_cell(&pincers, 0); a < NCELLS;
+	   a = next_cell(&pincers, a + 1))
+	for (b = next_cell(&pincers, a + 1); b < NCELLS;
+	     b = next_cell(&pincers, b + 1)) {
+	  int z = open_digits(g, a) & open_digits(g, b);
+	  if (xyz_wing(g, j, a, b)) {
+	    cells[0] = j;
+	    cells[1] = a;
+	    cells[2] = b;
+	    *d = first_digit(z);
+	    return kind;
+	  }
+	}
+    }
+    break;
+  case W_WING:
+    for (j = 0; j < bv.n; j++)
+      for (k = j + 1; k < bv.n; k++) {
+	a = bv.cells[j];
+	b = bv.cells[k];
+	int m = open_digits(g, a);
+	int x;
+	if (m != open_digits(g, b) || has_cell(&peers[a], b))
+	  continue;
+	for (x = 1; x <= DIGITS; x++)
+	  if (m & 1 << (x - 1) && w_wing(g, x, a, b)) {
+	    cells[0] = a;
+	    cells[1] = b;
+	    *d = x;
+	    return kind;
+	  }
+      }
+    break;
+  }
+  return 0;
+}
+
+/* The links between candidates. */
+
+typedef struct {
+  int strong_start[NCANDIDATES + 1];
+  short strong[NCANDIDATES * 4];
+  int weak_start[NCANDIDATES + 1];
+  short weak[NCANDIDATES * (DIGITS - 1 + 20)];
+} links;
+
+static links graph;
+
+static int
+is_candidate(const grid *g, int c)
+{
+  return open_digits(g, c / DIGITS) >> (c % DIGITS) & 1;
+}
+
+/* Are candidates a and b weakly linked? */
+
+static int
+weakly_linked(int a, int b)
+{
+  int i = a / DIGITS, j = b / DIGITS;
+  if (i == j)
+    return a != b;
+  return a % DIGITS == b % DIGITS && has_cell(&peers[i], j);
+}
+
+/* Build the links of the candidates of a board. */
+
+static void
+build_links(const grid *g, links *lk)
+{
+  int places[NHOUSES][DIGITS];	/* Number of places for each digit */
+  int ends[NHOUSES][DIGITS][2];	/* The first two of them */
+  int c, h, k, d, ns = 0, nw = 0;
+  for (h = 0; h < NHOUSES; h++)
+    for (d = 0; d < DIGITS; d++) {
+      places[h][d] = 0;
+      for (k = 0; k < DIGITS; k++) {
+	int j = house_cells[h][k];
+	if (open_digits(g, j) & 1 << d && places[h][d]++ < 2)
+	  ends[h][d][places[h][d] - 1] = j;
+      }
+    }
+  for (c = 0; c < NCANDIDATES; c++) {
+    lk->strong_start[c] = ns;
+    lk->weak_start[c] = nw;
+    if (!is_candidate(g, c))
+      continue;
+    int i = c / DIGITS;
+    int m = open_digits(g, i);
+    d = c % DIGITS;
+    if (popcount(m) == 2)	/* Bivalue cell */
+      lk->strong[ns++] = i * DIGITS + first_digit(m & ~(1 << d)) - 1;
+    for (k = 0; k < 3; k++) {
+      h = houses_of[i][k];
+      if (places[h][d] == 2) {	/* Conjugate pair */
+	int o = (ends[h][d][0] == i ? ends[h][d][1] : ends[h][d][0])
+	  * DIGITS + d;
+	int n, dup = 0;
+	for (n = lk->strong_start[c]; n < ns; n++)
+	  dup |= lk->strong[n] == o;
+	if (!dup)
+	  lk->strong[ns++] = o;
+      }
+    }
+    for (k = 0; k < DIGITS; k++)
+      if (k != d && m & 1 << k)
+	lk->weak[nw++] = i * DIGITS + k;
+    int j;
+    for (j = next_cell(&peers[i], 0); j < NCELLS;
+	 j = next_cell(&peers[i], j + 1))
+      if (open_digits(g, j) & 1 << d)
+	lk->weak[nw++] = j * DIGITS + d;
+  }
+  lk->strong_start[NCANDIDATES] = ns;
+  lk->weak_start[NCANDIDATES] = nw;
+}
+
+/* Are there candidates other than a and b that are weakly linked to
+   both?  Each such candidate is in the cell of a or is a peer of it
+   with the same digit.  If apply is non-zero, they are eliminated. */
+
+static int
+between(grid *g, int a, int b, int apply)
+{
+  int i = a / DIGITS, d = a % DIGITS;
+  int j, k, e = 0;
+  for (k = 0; k < DIGITS; k++) {
+    int c = i * DIGITS + k;
+    if (c != b && is_candidate(g, c) && weakly_linked(c, a)
+	&& weakly_linked(c, b)) {
+      if (apply)
+	g->vals[i] &= ~(1 << k);
+      e = 1;
+    }
+  }
+  for (j = next_cell(&peers[i], 0); j < NCELLS;
+       j = next_cell(&peers[i], j + 1)) {
+    int c = j * DIGITS + d;
+    if (c != b && is_candidate(g, c) && weakly_linked(c, b)) {
+      if (apply)
+	g->vals[j] &= ~(1 << d);
+      e = 1;
+    }
+  }
+  return e;
+}
+
+/* Color the candidates of digit d joined to the one in cell start by
+   strong links in houses, and eliminate the candidates of one color
+   when two of them see each other, or else the candidates that see
+   both colors. */
+
+static int
+color_from(grid *g, const links *lk, int d, int start, signed char color[])
+{
+  int queue[NCELLS], head = 0, tail = 0;
+  int c, k, e = 0;
+  color[start] = 0;
+  queue[tail++] = start;
+  while (head < tail) {
+    int i = queue[head++];
+    c = i * DIGITS + d;
+    for (k = lk->strong_start[c]; k < lk->strong_start[c + 1]; k++) {
+      int o = lk->strong[k];
+      if (o % DIGITS == d && color[o / DIGITS] < 0) {
+	color[o / DIGITS] = !color[i];
+	queue[tail++] = o / DIGITS;
+      }
+    }
+  }
+  if (tail < 3)
+    return 0;
+  int j, l;
+  for (j = 0; j < tail; j++)	/* Look for a color that sees itself */
+    for (l = j + 1; l < tail; l++)
+      if (color[queue[j]] == color[queue[l]]
+	  && has_cell(&peers[queue[j]], queue[l])) {
+	int bad = color[queue[j]];
+	for (k = 0; k < tail; k++)
+	  if (color[queue[k]] == bad) {
+	    g->vals[queue[k]] &= ~(1 << d);
+	    e = 1;
+	  }
+	return e;
+      }
+  for (j = 0; j < NCELLS; j++) { /* Look for cells that see both */
+    if (color[j] >= 0 || !(open_digits(g, j) & 1 << d))
+      continue;
+    int seen = 0;
+    for (k = 0; k < tail; k++)
+      if (has_cell(&peers[j], queue[k]))
+	seen |= 1 << color[queue[k]];
+    if (seen == 3) {
+      g->vals[j] &= ~(1 << d);
+      e = 1;
+    }
+  }
+  return e;
+}
+
+int
+coloring(grid *g, int d, int start)
+{
+  if (d < 1 || d > DIGITS || start < 0 || start >= NCELLS
+      || !(open_digits(g, start) & 1 << (d - 1)))
+    return 0;
+  signed char color[NCELLS];
+  memset(color, -1, sizeof color);
+  build_links(g, &graph);
+  return color_from(g, &graph, d - 1, start, color);
+}
+
+int
+find_coloring(grid *g, int d, int *start)
+{
+  int i, k;
+  build_links(g, &graph);
+  for (k = 1; k <= DIGITS; k++) {
+    if (d && k != d)
+      continue;
+    signed char color[NCELLS];
+    memset(color, -1, sizeof color);
+    for (i = 0; i < NCELLS; i++)
+      if (color[i] < 0 && open_digits(g, i) & 1 << (k - 1)
+	  && color_from(g, &graph, k - 1, i, color)) {
+	*start = i;
+	return k;
+      }
+  }
+  return 0;
+}
+
+/* Search for a chain from candidate s, assumed false, by breadth
+   first search over the candidates, each reached as true or false.
+   A true candidate is reached from a false one over a strong link,
+   and a false one from a true one over a weak link.  When a true
+   candidate t is reached, either s or t holds, so the candidates
+   weakly linked to both are eliminated.  When d is non-negative,
+   only candidates of digit d are used.  Returns the length of the
+   chain found, or zero when there is none. */
+
+static int
+search_chain(grid *g, const links *lk, int d, int s, int chain[])
+{
+  short prev[2 * NCANDIDATES];	/* A state is a candidate and a truth */
+  unsigned char depth[2 * NCANDIDATES];
+  int queue[2 * NCANDIDATES], head = 0, tail = 0;
+  memset(depth, 0, sizeof depth);
+  depth[2 * s] = 1;
+  prev[2 * s] = -1;
+  queue[tail++] = 2 * s;
+  while (head < tail) {
+    int u = queue[head++];
+    int c = u / 2, truth = u % 2;
+    if (depth[u] >= MAX_CHAIN)
+      continue;
+    const short *adj = truth ? lk->weak : lk->strong;
+    const int *start = truth ? lk->weak_start : lk->strong_start;
+    int k;
+    for (k = start[c]; k < start[c + 1]; k++) {
+      int o = adj[k];
+      int v = 2 * o + !truth;
+      if ((d >= 0 && o % DIGITS != d) || depth[v])
+	continue;
+      depth[v] = depth[u] + 1;
+      prev[v] = u;
+      queue[tail++] = v;
+      if (!truth && depth[v] >= 4 && o != s && between(g, s, o, 0)) {
+	between(g, s, o, 1);
+	int n = depth[v], w;
+	for (w = v; w >= 0; w = prev[w])
+	  chain[--n] = w / 2;
+	return depth[v];
+      }
+    }
+  }
+  return 0;
+}
+
+int
+find_chain(grid *g, int d, int chain[MAX_CHAIN])
+{
+  int c;
+  build_links(g, &graph);
+  for (c = 0; c < NCANDIDATES; c++) {
+    if ((d && c % DIGITS != d - 1) || !is_candidate(g, c)
+	|| graph.strong_start[c] == graph.strong_start[c + 1])
+      continue;
+    int n = search_chain(g, &graph, d ? d - 1 : -1, c, chain);
+    if (n)
+      return n;
+  }
+  return 0;
+}
+
+/* The catalogue of almost locked sets. */
+
+#define MAX_ALS (NHOUSES * ALL)
+
+typedef struct {
+  cellset cells;
+  int digits;
+} als_entry;
+
+static als_entry catalogue[MAX_ALS];
+static int ncatalogue;
+static cellset places_of[DIGITS]; /* The places for each digit */
+
+static void
+build_catalogue(const grid *g)
+{
+  int h, k, d, s;
+  for (d = 0; d < DIGITS; d++) {
+    places_of[d].w[0] = places_of[d].w[1] = 0;
+    for (k = 0; k < NCELLS; k++)
+      if (open_digits(g, k) & 1 << d)
+	add_cell(&places_of[d], k);
+  }
+  ncatalogue = 0;
+  for (h = 0; h < NHOUSES; h++) {
+    int open = 0;
+    for (k = 0; k < DIGITS; k++)
+      if (open_digits(g, house_cells[h][k]))
+	open |= 1 << k;
+    for (s = open; s; s = (s - 1) & open) {
+      int digits = 0, square = -1, one_square = 1;
+      for (k = 0; k < DIGITS; k++)
+	if (s & 1 << k) {
+	  int i = house_cells[h][k];
+	  digits |= open_digits(g, i);
+	  if (square < 0)
+	    square = houses_of[i][0];
+	  one_square &= square == houses_of[i][0];
+	}
+      if (popcount(digits) != popcount(s) + 1)
+	continue;
+      if (h >= DIGITS && one_square)
+	continue;		/* Found in the square */
+      als_entry *a = &catalogue[ncatalogue++];
+      a->cells.w[0] = a->cells.w[1] = 0;
+      a->digits = digits;
+      for (k = 0; k < DIGITS; k++)
+	if (s & 1 << k)
+	  add_cell(&a->cells, house_cells[h][k]);
+    }
+  }
+}
+
+static int
+empty(cellset s)
+{
+  return !s.w[0] && !s.w[1];
+}
+
+/* Is every cell in a also in b? */
+
+static int
+within(cellset a, cellset b)
+{
+  return !(a.w[0] & ~b.w[0]) && !(a.w[1] & ~b.w[1]);
+}
+
+static cellset
+join(cellset a, cellset b)
+{
+  a.w[0] |= b.w[0];
+  a.w[1] |= b.w[1];
+  return a;
+}
+
+/* The cells that see every cell in s. */
+
+static cellset
+seen_by_all(cellset s)
+{
+  cellset seen = {{~UINT64_C(0), ~UINT64_C(0)}};
+  int i;
+  for (i = next_cell(&s, 0); i < NCELLS; i = next_cell(&s, i + 1))
+    seen = intersect(seen, peers[i]);
+  return seen;
+}
+
+/* The restricted common digits of two sets that do not overlap: the
+   digits in both, where each place for the digit in one sees each
+   place for it in the other. */
+
+static int
+restricted(const als_entry *a, const als_entry *b)
+{
+  int common = a->digits & b->digits, rcc = 0, d;
+  if (!common || !empty(intersect(a->cells, b->cells)))
+    return 0;
+  for (d = 0; d < DIGITS; d++)
+    if (common & 1 << d) {
+      cellset x = intersect(a->cells, places_of[d]);
+      cellset y = intersect(b->cells, places_of[d]);
+      if (within(y, seen_by_all(x)))
+	rcc |= 1 << d;
+    }
+  return rcc;
+}
+
+/* Eliminate the digits in zs from the cells outside sets that see
+   every place for the digit in sets. */
+
+static int
+eliminate_seen(grid *g, cellset sets, int zs)
+{
+  int d, e = 0;
+  for (d = 0; d < DIGITS; d++)
+    if (zs & 1 << d) {
+      cellset seen = seen_by_all(intersect(sets, places_of[d]));
+      e |= eliminate(g, 1 << d, &seen);
+    }
+  return e;
+}
+
+static void
+export_als(const als_entry *a, als_set *out)
+{
+  int i;
+  out->n = 0;
+  out->digits = a->digits;
+  for (i = next_cell(&a->cells, 0); i < NCELLS;
+       i = next_cell(&a->cells, i + 1))
+    out->cells[out->n++] = i;
+}
+
+/* Look for two sets with a restricted common digit x.  Another digit
+   z in both sets is in one or the other, so z is eliminated from the
+   cells that see each place for z in the two sets. */
+
+static int
+find_als_xz(grid *g, long budget, als_set sets[], int *x, int *z)
+{
+  int j, k;
+  for (j = 0; j < ncatalogue; j++)
+    for (k = j + 1; k < ncatalogue; k++) {
+      if (budget && --budget == 0)
+	return 0;
+      const als_entry *a = &catalogue[j], *b = &catalogue[k];
+      int rcc = restricted(a, b);
+      if (!rcc)
+	continue;
+      int d = first_digit(rcc) - 1;
+      int zs = a->digits & b->digits & ~(1 << d);
+      if (eliminate_seen(g, join(a->cells, b->cells), zs)) {
+	export_als(a, &sets[0]);
+	export_als(b, &sets[1]);
+	*x = d + 1;
+	*z = zs;
+	return ALS_XZ;
+      }
+    }
+  return 0;
+}
+
+/* Look for sets a and b that have restricted common digits x and y
+   with a third set c.  If neither a nor b holds the other digits they
+   share, c holds both x and y, which is one digit too many, so a digit
+   z in a and b is eliminated from the cells that see each place for z
+   in them. */
+
+static int
+find_als_xy(grid *g, long budget, als_set sets[], int *x, int *y, int *z)
+{
+  static int linked[MAX_ALS], link_rcc[MAX_ALS];
+  int j, k, l;
+  for (l = 0; l < ncatalogue; l++) {
+    const als_entry *c = &catalogue[l];
+    int n = 0;
+    for (j = 0; j < ncatalogue; j++) {
+      if (budget && --budget == 0)
+	return 0;
+      int rcc = j == l ? 0 : restricted(&catalogue[j], c);
+      if (rcc) {
+	linked[n] = j;
+	link_rcc[n++] = rcc;
+      }
+    }
+    for (j = 0; j < n; j++)
+      for (k = j + 1; k < n; k++) {
+	if (budget && --budget == 0)
+	  return 0;
+	const als_entry *a = &catalogue[linked[j]];
+	const als_entry *b = &catalogue[linked[k]];
+	if (!empty(intersect(a->cells, b->cells)))
+	  continue;
+	int xs = link_rcc[j], ys = link_rcc[k], dx, dy;
+	for (dx = 0; dx < DIGITS; dx++)
+	  for (dy = 0; dy < DIGITS; dy++) {
+	    if (dx == dy || !(xs & 1 << dx) || !(ys & 1 << dy))
+	      continue;
+	    int zs = a->digits & b->digits & ~(1 << dx | 1 << dy);
+	    if (eliminate_seen(g, join(a->cells, b->cells), zs)) {
+	      export_als(a, &sets[0]);
+	      export_als(b, &sets[1]);
+	      export_als(c, &sets[2]);
+	      *x = dx + 1;
+	      *y = dy + 1;
+	      *z = zs;
+	      return ALS_XY_WING;
+	    }
+	  }
+      }
+  }
+  return 0;
+}
+
+int
+find_als(grid *g, int kind, long budget, als_set sets[3],
+	 int *x, int *y, int *z)
+{
+  build_catalogue(g);
+  switch (kind) {
+  case ALS_XZ:
+    *y = 0;
+    return find_als_xz(g, budget, sets, x, z);
+  case ALS_XY_WING:
+    return find_als_xy(g, budget, sets, x, y, z);
+  }
+  return 0;
+}
+
+/* Is there a house other than h in which cells i and j both lie? */
+
+static int
+share_house(int i, int j, int h[3])
+{
+  int k, n = 0;
+  for (k = 0; k < 3; k++)
+    if (houses_of[i][k] == houses_of[j][k])
+      h[n++] = houses_of[i][k];
+  return n;
+}
+
+/* Type 3: the extra digits of the roof act as one cell, and with
+   other cells in house h form a naked subset, whose digits are
+   eliminated from the rest of the house. */
+
+static int
+ur_subset(grid *g, int h, int roof0, int roof1, int extra)
+{
+  int others = 0, k, s;
+  for (k = 0; k < DIGITS; k++) {
+    int i = house_cells[h][k];
+    if (i != roof0 && i != roof1 && open_digits(g, i))
+      others |= 1 << k;
+  }
+  for (s = others; s; s = (s - 1) & others) {
+    int digits = extra;
+    for (k = 0; k < DIGITS; k++)
+      if (s & 1 << k)
+	digits |= open_digits(g, house_cells[h][k]);
+    if (popcount(digits) != popcount(s) + 1)
+      continue;
+    int e = 0;
+    for (k = 0; k < DIGITS; k++)
+      if (others & ~s & 1 << k) {
+	int i = house_cells[h][k];
+	if (g->vals[i] & digits) {
+	  g->vals[i] &= ~digits;
+	  e = 1;
+	}
+      }
+    if (e)
+      return 1;
+  }
+  return 0;
+}
+
+/* Apply the rules to the rectangle with the given corners and the
+   pair of digits m.  The corners with just the pair are the floor,
+   and the others are the roof. */
+
+static int
+ur_pair(grid *g, const int corners[4], int m)
+{
+  int roof[4], nf = 0, nr = 0, k;
+  for (k = 0; k < 4; k++) {
+    int v = open_digits(g, corners[k]);
+    if ((v & m) != m)
+      return 0;
+    if (v == m)
+      nf++;			/* A corner of the floor */
+    else
+      roof[nr++] = corners[k];
+  }
+  if (nf == 3) {
+    g->vals[roof[0]] &= ~m;
+    return 1;
+  }
+  int h[3], nh;
+  if (nf != 2 || !(nh = share_house(roof[0], roof[1], h)))
+    return 0;			/* No pattern, or roof on a diagonal */
+  int extra0 = open_digits(g, roof[0]) & ~m;
+  int extra1 = open_digits(g, roof[1]) & ~m;
+  if (extra0 == extra1 && popcount(extra0) == 1) {
+    cellset seen = intersect(peers[roof[0]], peers[roof[1]]);
+    if (eliminate(g, extra0, &seen))
+      return 2;
+  }
+  int j;
+  for (j = 0; j < nh; j++)
+    if (ur_subset(g, h[j], roof[0], roof[1], extra0 | extra1))
+      return 3;
+  for (j = 0; j < nh; j++)
+    for (k = 0; k < DIGITS; k++) {
+      int x = 1 << k;
+      if (!(m & x))
+	continue;
+      int places = 0, l;
+      for (l = 0; l < DIGITS; l++)
+	if (open_digits(g, house_cells[h[j]][l]) & x)
+	  places++;
+      if (places == 2) {	/* Only in the roof */
+	g->vals[roof[0]] &= ~(m & ~x);
+	g->vals[roof[1]] &= ~(m & ~x);
+	return 4;
+      }
+    }
+  return 0;
+}
+
+int
+unique_rectangle(grid *g, int a, int d)
+{
+  if (a < 0 || a >= NCELLS || d < 0 || d >= NCELLS)
+    return 0;
+  int r1 = a / DIGITS, c1 = a % DIGITS, r2 = d / DIGITS, c2 = d % DIGITS;
+  if (r1 == r2 || c1 == c2
+      || (r1 / SIDES == r2 / SIDES) == (c1 / SIDES == c2 / SIDES))
+    return 0;			/* Not a rectangle in two squares */
+  int corners[4] = {a, r1 * DIGITS + c2, r2 * DIGITS + c1, d};
+  int k;
+  for (k = 0; k < 4; k++) {
+    int m = open_digits(g, corners[k]);
+    int type = popcount(m) == 2 ? ur_pair(g, corners, m) : 0;
+    if (type)
+      return type;
+  }
+  return 0;
+}
+
+int
+find_unique_rectangle(grid *g, int *a, int *d)
+{
+  bivalues bv;
+  index_bivalues(g, &bv);
+  int j, r, c;
+  for (j = 0; j < bv.n; j++) {
+    int i = bv.cells[j];
+    for (r = 0; r < DIGITS; r++)
+      for (c = 0; c < DIGITS; c++) {
+	int type = unique_rectangle(g, i, r * DIGITS + c);
+	if (type) {
+	  *a = i;
+	  *d = r * DIGITS + c;
+	  return type;
+	}
+      }
+  }
+  return 0;
+}
+
+int
+bug_plus_one(grid *g, int *cell)
+{
+  int i, k, extra = -1;
+  for (i = 0; i < NCELLS; i++) {
+    int n = popcount(open_digits(g, i));
+    if (n == 3 && extra < 0)
+      extra = i;
+    else if (n && n != 2)
+      return 0;
+  }
+  if (extra < 0)
+    return 0;
+  int m = open_digits(g, extra);
+  for (k = 0; k < 3; k++) {
+    int h = houses_of[extra][k], d, l;
+    for (d = 0; d < DIGITS; d++) {
+      if (!(m & 1 << d))
+	continue;
+      int places = 0;
+      for (l = 0; l < DIGITS; l++)
+	if (open_digits(g, house_cells[h][l]) & 1 << d)
+	  places++;
+      if (places == 3) {
+	g->vals[extra] = 1 << d;
+	*cell = extra;
+	return d + 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/* The pattern overlay method. */
+
+#define NTEMPLATES 46656
+
+/* The templates are built in order of their cell in the first row,
+   so each column of that row starts a block of this many. */
+#define BLOCK (NTEMPLATES / DIGITS)
+
+/* Cells 0 to 63 of each template are in the low words, and the rest
+   in the high words. */
+static uint64_t template_lo[NTEMPLATES];
+static uint64_t template_hi[NTEMPLATES];
+static int ntemplates;
+
+/* Extend the templates with a cell in each row from row on, given
+   the columns and squares used, and the cells chosen so far. */
+
+static void
+build_templates(int row, int cols, int squares, cellset s)
+{
+  if (row == DIGITS) {
+    template_lo[ntemplates] = s.w[0];
+    template_hi[ntemplates] = s.w[1];
+    ntemplates++;
+    return;
+  }
+  int col;
+  for (col = 0; col < DIGITS; col++) {
+    int square = row / SIDES * SIDES + col / SIDES;
+    if (cols & 1 << col || squares & 1 << square)
+      continue;
+    cellset t = s;
+    add_cell(&t, row * DIGITS + col);
+    build_templates(row + 1, cols | 1 << col, squares | 1 << square, t);
+  }
+}
+
+int
+pattern_overlay(grid *g, int d, int cells[NCELLS])
+{
+  if (!ntemplates) {
+    cellset none = {{0, 0}};
+    build_templates(0, 0, 0, none);
+  }
+  int bit = 1 << (d - 1);
+  cellset possible = {{0, 0}}, placed = {{0, 0}};
+  int i, n = 0;
+  for (i = 0; i < NCELLS; i++) {
+    if (g->vals[i] & bit)
+      add_cell(&possible, i);
+    if (g->determined[i] && g->vals[i] == bit)
+      add_cell(&placed, i);
+    n += (open_digits(g, i) & bit) != 0;
+  }
+  if (!n)
+    return 0;
+  /* A template fits when it misses no placed cell and has no cell in
+     which d is not possible. */
+  uint64_t out_lo = ~possible.w[0], out_hi = ~possible.w[1];
+  uint64_t in_lo = placed.w[0], in_hi = placed.w[1];
+  uint64_t cover_lo = 0, cover_hi = 0, fits = 0;
+  int col;
+  for (col = 0; col < DIGITS; col++) {
+    /* The templates with a cell in column col of the first row */
+    if (!has_cell(&possible, col))
+      continue;
+    int t = col * BLOCK, end = t + BLOCK;
+#if defined __SSE2__
+    __m128i v_out_lo = _mm_set1_epi64x(out_lo);
+    __m128i v_out_hi = _mm_set1_epi64x(out_hi);
+    __m128i v_in_lo = _mm_set1_epi64x(in_lo);
+    __m128i v_in_hi = _mm_set1_epi64x(in_hi);
+    __m128i zero = _mm_setzero_si128();
+    __m128i v_cover_lo = zero, v_cover_hi = zero, v_fits = zero;
+    for (; t < end; t += 2) {
+      __m128i lo = _mm_loadu_si128((const __m128i *)&template_lo[t]);
+      __m128i hi = _mm_loadu_si128((const __m128i *)&template_hi[t]);
+      __m128i miss =
+	_mm_or_si128(_mm_or_si128(_mm_and_si128(lo, v_out_lo),
+				  _mm_and_si128(hi, v_out_hi)),
+		     _mm_or_si128(_mm_andnot_si128(lo, v_in_lo),
+				  _mm_andnot_si128(hi, v_in_hi)));
+      /* SSE2 compares 32-bit lanes, so both halves must be zero */
+      __m128i keep = _mm_cmpeq_epi32(miss, zero);
+      keep = _mm_and_si128(keep, _mm_shuffle_epi32(keep, 0xb1));
+      v_cover_lo = _mm_or_si128(v_cover_lo, _mm_and_si128(lo, keep));
+      v_cover_hi = _mm_or_si128(v_cover_hi, _mm_and_si128(hi, keep));
+      v_fits = _mm_or_si128(v_fits, keep);
+    }
+    uint64_t w[2];
+    _mm_storeu_si128((__m128i *)w, v_cover_lo);
+    cover_lo |= w[0] | w[1];
+    _mm_storeu_si128((__m128i *)w, v_cover_hi);
+    cover_hi |= w[0] | w[1];
+    _mm_storeu_si128((__m128i *)w, v_fits);
+    fits |= w[0] | w[1];
+#else
+    for (; t < end; t++) {
+      uint64_t lo = template_lo[t], hi = template_hi[t];
+      uint64_t miss = (lo & out_lo) | (hi & out_hi)
+	| (in_lo & ~lo) | (in_hi & ~hi);
+      uint64_t keep = (uint64_t)(miss != 0) - 1;
+      cover_lo |= lo & keep;
+      cover_hi |= hi & keep;
+      fits |= keep;
+    }
+#endif
+  }
+  if (!fits)			/* The board has no solution */
+    return 0;
+  cellset cover = {{cover_lo, cover_hi}};
+  n = 0;
+  for (i = 0; i < NCELLS; i++)
+    if (open_digits(g, i) & bit && !has_cell(&cover, i)) {
+      g->vals[i] &= ~bit;
+      cells[n++] = i;
+    }
+  return n;
+}
+
+int
+find_pattern_overlay(grid *g, int *d, int cells[NCELLS])
+{
+  for (*d = 1; *d <= DIGITS; (*d)++) {
+    int n = pattern_overlay(g, *d, cells);
+    if (n)
+      return n;
+  }
+  return 0;
+}
+
+/* Nishio. */
+
+/* A cell determined during a trial, and the step that forced it, or
+   -1 for the candidate tried. */
+typedef struct {
+  int cell;
+  int digit;
+  int cause;
+} step;
+
+/* The undo log holds the old contents of each cell a trial changed. */
+static struct {
+  int n;
+  int cells[NCELLS];
+  int vals[NCELLS];
+  int determined[NCELLS];
+  cellset saved;
+} undo;
+
+static step steps[NCELLS];	/* The steps of a trial, in order */
+static int nsteps;
+
+/* Singles waiting to be determined.  A single is queued once for each
+   elimination that makes it, so the queue is bounded by four times
+   the number of candidates. */
+#define MAX_PENDING (4 * NCANDIDATES)
+static step pending[MAX_PENDING];
+static int head, tail;
+
+static void
+save(const grid *g, int i)
+{
+  if (has_cell(&undo.saved, i))
+    return;
+  add_cell(&undo.saved, i);
+  undo.cells[undo.n] = i;
+  undo.vals[undo.n] = g->vals[i];
+  undo.determined[undo.n] = g->determined[i];
+  undo.n++;
+}
+
+static void
+restore(grid *g)
+{
+  while (undo.n > 0) {
+    undo.n--;
+    int i = undo.cells[undo.n];
+    g->vals[i] = undo.vals[undo.n];
+    g->determined[i] = undo.determined[undo.n];
+  }
+  memset(&undo.saved, 0, sizeof undo.saved);
+}
+
+static void
+enqueue(int i, int d, int cause)
+{
+  pending[tail].cell = i;
+  pending[tail].digit = d;
+  pending[tail].cause = cause;
+  tail++;
+}
+
+/* Record the contradiction reached by step cause. */
+
+static int
+contradiction(forcing_chain *fc, int kind, int where, int d, int cause)
+{
+  fc->kind = kind;
+  fc->where = where;
+  fc->digit = d;
+  int n = 0, s;
+  for (s = cause; s >= 0; s = steps[s].cause)
+    n++;
+  fc->n = n;
+  for (s = cause; s >= 0; s = steps[s].cause) {
+    n--;
+    fc->cells[n] = steps[s].cell;
+    fc->digits[n] = steps[s].digit;
+  }
+  return 1;
+}
+
+/* Eliminate digit d from cell i as a consequence of step cause, and
+   queue the singles it makes.  Returns non-zero at a contradiction. */
+
+static int
+trial_eliminate(grid *g, int i, int d, int cause, forcing_chain *fc)
+{
+  int bit = 1 << (d - 1);
+  if (!(g->vals[i] & bit))
+    return 0;
+  save(g, i);
+  g->vals[i] &= ~bit;
+  if (!g->vals[i])
+    return contradiction(fc, NO_DIGIT, i, 0, cause);
+  if (!g->determined[i] && popcount(g->vals[i]) == 1)
+    enqueue(i, first_digit(g->vals[i]), cause);
+  int k, l;
+  for (k = 0; k < 3; k++) {
+    int h = houses_of[i][k], places = 0, place = 0;
+    for (l = 0; l < DIGITS; l++)
+      if (g->vals[house_cells[h][l]] & bit) {
+	places++;
+	place = house_cells[h][l];
+      }
+    if (!places)
+      return contradiction(fc, NO_PLACE, h, d, cause);
+    if (places == 1 && !g->determined[place])
+      enqueue(place, d, cause);
+  }
+  return 0;
+}
+
+/* Place digit d in cell i and determine singles until none are left
+   or a contradiction is reached, which is described in fc.  Returns
+   non-zero at a contradiction.  The board is left changed. */
+
+static int
+trial(grid *g, int i, int d, forcing_chain *fc)
+{
+  nsteps = 0;
+  head = tail = 0;
+  enqueue(i, d, -1);
+  while (head < tail) {
+    step p = pending[head++];
+    int bit = 1 << (p.digit - 1);
+    if (g->determined[p.cell] || !(g->vals[p.cell] & bit))
+      continue;
+    int s = nsteps++, x, j;
+    steps[s] = p;
+    save(g, p.cell);
+    g->determined[p.cell] = 1;
+    for (x = 1; x <= DIGITS; x++)
+      if (x != p.digit && trial_eliminate(g, p.cell, x, s, fc))
+	return 1;
+    for (j = next_cell(&peers[p.cell], 0); j < NCELLS;
+	 j = next_cell(&peers[p.cell], j + 1))
+      if (trial_eliminate(g, j, p.digit, s, fc))
+	return 1;
+  }
+  return 0;
+}
+
+int
+nishio(grid *g, int i, int d, forcing_chain *fc)
+{
+  if (!(open_digits(g, i) & 1 << (d - 1)))
+    return 0;
+  int e = trial(g, i, d, fc);
+  restore(g);
+  if (!e)
+    return 0;
+  g->vals[i] &= ~(1 << (d - 1));
+  return fc->n;
+}
+
+int
+find_nishio(grid *g, forcing_chain *fc)
+{
+  static forcing_chain trying;
+  int i, d;
+  fc->n = 0;
+  for (i = 0; i < NCELLS; i++)
+    for (d = 1; d <= DIGITS; d++) {
+      if (!(open_digits(g, i) & 1 << (d - 1)))
+	continue;
+      int e = trial(g, i, d, &trying);
+      restore(g);
+      if (e && (!fc->n || trying.n < fc->n))
+	*fc = trying;
+    }
+  if (fc->n)
+    g->vals[fc->cells[0]] &= ~(1 << (fc->digits[0] - 1));
+  return fc->n;
+}
@@ -0,0 +1,217 @@
+/* Rules that work on a board as an array of digit sets. */
+
+#ifndef RULES_H
+#define RULES_H
+
+/* A board as seen by these rules.  The cells are in row major order,
+   and each is a set of digits, with digit d as bit d - 1, and a flag
+   that is non-zero when the cell is determined. */
+typedef struct {
+  int vals[NCELLS];
+  int determined[NCELLS];
+} grid;
+
+/* The houses are numbered from zero so that houses 0 to 8 are the
+   squares in row major order, houses 9 to 17 are the rows, and houses
+   18 to 26 are the columns. */
+#define NHOUSES (3 * DIGITS)
+
+/* The cells of house h, in order. */
+extern int house_cells[NHOUSES][DIGITS];
+
+/* Fills in house_cells.  Call before using any rule. */
+void rules_init(void);
+
+/* Kinds of subsets. */
+#define NAKED_SUBSET 1
+#define HIDDEN_SUBSET 2
+
+/* If the undetermined cells of house h whose digits are all in set
+   number as many as the digits in set, the digits in set are
+   eliminated from the other cells in the house.  Returns non-zero
+   when a digit is eliminated. */
+int naked_subset(grid *g, int h, int set);
+
+/* If the digits in set are possible in just as many undetermined
+   cells of house h, and each digit is possible in one of them, the
+   other digits in those cells are eliminated.  Returns non-zero when
+   a digit is eliminated. */
+int hidden_subset(grid *g, int h, int set);
+
+/* Looks for a naked or hidden subset of n digits in any house that
+   eliminates a digit, and applies the first found.  Returns its
+   kind, and sets its house and set of digits, or returns zero when
+   there is none. */
+int find_subset(grid *g, int n, int *h, int *set);
+
+/* Kinds of fish, by the lines of their base. */
+#define ROW_FISH 1
+#define COLUMN_FISH 2
+
+/* If digit d is possible in the lines of the base, a set of rows or
+   columns, only at as many crossing lines as there are lines in the
+   base, d is eliminated from the rest of the crossing lines.  When
+   finned is non-zero and the other places for d in the base lie in
+   one square, d is eliminated from the places in the crossing lines
+   and that square.  Returns non-zero when a digit is eliminated. */
+int fish(grid *g, int d, int kind, int base, int finned);
+
+/* Looks for a fish with n lines in its base, finned or not, that
+   eliminates a digit, and applies the first found.  Returns its kind,
+   and sets its digit and base, or returns zero when there is none. */
+int find_fish(grid *g, int n, int finned, int *d, int *base);
+
+/* Wings.  Cells are numbered from zero in row major order.  An
+   XY-Wing has a pivot p with two digits, x and y, that sees two
+   pincers a and b, one with x and z and the other with y and z, so z
+   is eliminated from the cells that see both pincers.  An XYZ-Wing is
+   the same but for a pivot with x, y, and z, so z is eliminated only
+   from the cells that see all three.  Each returns non-zero when a
+   digit is eliminated. */
+int xy_wing(grid *g, int p, int a, int b);
+int xyz_wing(grid *g, int p, int a, int b);
+
+/* A W-Wing is two cells a and b that do not see each other, with the
+   same two digits, one of them d, and a house in which d has just
+   two places, one seen by a and the other by b.  The other digit is
+   eliminated from the cells that see both a and b.  Returns non-zero
+   when a digit is eliminated. */
+int w_wing(grid *g, int d, int a, int b);
+
+/* Kinds of wings. */
+#define XY_WING 1
+#define XYZ_WING 2
+#define W_WING 3
+
+/* Looks for a wing of the given kind that eliminates a digit, and
+   applies the first found.  Returns its kind, and sets its cells,
+   the pivot first, and its digit, or returns zero when there is
+   none.  The digit is the one eliminated, except for a W-Wing, whose
+   digit is that of its link, and which has only two cells. */
+int find_wing(grid *g, int kind, int cells[3], int *d);
+
+/* Chains.  A candidate is a digit possible in an undetermined cell,
+   with digit d in cell i numbered i * DIGITS + d - 1. */
+#define NCANDIDATES (NCELLS * DIGITS)
+
+/* The most candidates in a chain. */
+#define MAX_CHAIN 16
+
+/* Simple coloring of digit d from the candidate in cell start.  The
+   candidates of d joined to it by houses with just two places for d
+   are given alternating colors, and all of one color hold d.  If two
+   cells of one color see each other, d is eliminated from the cells
+   of that color, else d is eliminated from cells that see both
+   colors.  Returns non-zero when a digit is eliminated. */
+int coloring(grid *g, int d, int start);
+
+/* Looks for a coloring of digit d, or of any digit when d is zero,
+   that eliminates a digit, and applies the first found.  Returns its
+   digit and sets its start, or returns zero when there is none. */
+int find_coloring(grid *g, int d, int *start);
+
+/* Looks for an alternating inference chain that eliminates a digit,
+   and applies the first found.  The chain starts with a strong link,
+   alternates weak and strong links, and ends with a strong link, so
+   one of its ends holds, and candidates weakly linked to both ends
+   are eliminated.  When d is non-zero, only candidates of digit d are
+   used, making an X-Chain.  Returns the number of candidates in the
+   chain, and sets them in order, or returns zero when there is
+   none. */
+int find_chain(grid *g, int d, int chain[MAX_CHAIN]);
+
+/* An almost locked set is n cells in one house with n + 1 digits
+   possible among them. */
+typedef struct {
+  int n;
+  int cells[DIGITS];
+  int digits;
+} als_set;
+
+/* Kinds of rules about almost locked sets. */
+#define ALS_XZ 1
+#define ALS_XY_WING 2
+
+/* Looks for an ALS-XZ or an ALS-XY-Wing that eliminates a digit, and
+   applies the first found.  Returns its kind, sets its sets, and sets
+   the digits x and y of its restricted common digits, and the set of
+   digits z that were eliminated, or returns zero when there is none.
+   An ALS-XZ has two sets and no y.  The search gives up after budget
+   steps, unless budget is zero. */
+int find_als(grid *g, int kind, long budget, als_set sets[3],
+	     int *x, int *y, int *z);
+
+/* Rules that assume the puzzle has a unique solution. */
+
+/* Applies the unique rectangle rules to the rectangle with opposite
+   corners a and d, which must lie in two squares.  The four corners
+   have the same two digits possible, and are not all limited to
+   them, as the digits could then be swapped in a second solution.
+   Type 1 has one corner with other digits, from which the pair is
+   eliminated.  The rest have two corners with other digits in one
+   row or column.  If they share one other digit, type 2 eliminates it
+   from cells that see both.  If their other digits form a naked
+   subset with cells in a house they share, type 3 eliminates those
+   digits from the rest of the house.  If one digit of the pair is
+   possible only in them in a house they share, type 4 eliminates the
+   other digit of the pair from them.  Returns the type applied, or
+   zero when none eliminates a digit. */
+int unique_rectangle(grid *g, int a, int d);
+
+/* Looks for a unique rectangle that eliminates a digit, and applies
+   the first found.  Returns its type and sets its opposite corners,
+   or returns zero when there is none. */
+int find_unique_rectangle(grid *g, int *a, int *d);
+
+/* If every undetermined cell has two digits possible but one cell,
+   which has three, that cell holds the digit that is possible three
+   times in one of its houses, as the board would otherwise have more
+   than one solution.  Returns that digit and sets the cell, or
+   returns zero when the rule does not apply. */
+int bug_plus_one(grid *g, int *cell);
+
+/* The pattern overlay method.  A template of digit d is a set of
+   nine cells, one in each row, column, and square, that holds every
+   cell determined to be d and has d possible in the rest.  Digit d is
+   eliminated from each undetermined cell in no template.  Returns the
+   number of cells from which d was eliminated, and sets them. */
+int pattern_overlay(grid *g, int d, int cells[NCELLS]);
+
+/* Applies the pattern overlay method to each digit in turn, until one
+   eliminates a digit.  Returns the number of cells from which it was
+   eliminated, and sets the digit and the cells, or returns zero when
+   there is none. */
+int find_pattern_overlay(grid *g, int *d, int cells[NCELLS]);
+
+/* Nishio.  A forcing chain leads from a candidate tried to a
+   contradiction.  Each of its steps is a cell and the digit it must
+   then hold, the first being the candidate tried, and each following
+   from the one before and the steps before it.  The contradiction
+   follows from the last step. */
+typedef struct {
+  int n;
+  int cells[NCELLS];
+  int digits[NCELLS];
+  int kind;			/* The kind of contradiction */
+  int where;			/* The cell or house of the contradiction */
+  int digit;			/* The digit with no place */
+} forcing_chain;
+
+/* Kinds of contradiction. */
+#define NO_DIGIT 1		/* A cell has no digit possible */
+#define NO_PLACE 2		/* A digit has no place in a house */
+
+/* Places digit d in cell i and determines naked and hidden singles
+   until none are left.  If a contradiction is reached, d is
+   eliminated from cell i.  The board is otherwise unchanged.  Returns
+   the number of steps in the forcing chain to the contradiction, and
+   sets it, or returns zero when there is none. */
+int nishio(grid *g, int i, int d, forcing_chain *fc);
+
+/* Tries every candidate on the board, and eliminates the one with the
+   shortest forcing chain to a contradiction.  Returns the number of
+   steps in the chain, and sets it, or returns zero when there is
+   none. */
+int find_nishio(grid *g, forcing_chain *fc);
+
+#endif
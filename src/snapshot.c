@@ -0,0 +1,166 @@
+/*
+ * Boards and their history as binary snapshots.
+ *
+ * Copyright (C) 2006 John D. Ramsdell
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "config.h"
+#include "gtksudoku.h"
+#include "board.h"
+#include "snapshot.h"
+
+/* The header is the magic number, the version, the flags, and the
+   number of boards. */
+static const unsigned char magic[] = {'G', 'S', 'S'};
+#define FORMAT 1		/* Version of the format */
+#define HEADER 8
+
+/* Flags. */
+#define DETAILS 1
+
+/* Bytes used by the sets of digits and the determined bitmap of a
+   board. */
+#define VALS_SIZE ((NCELLS * DIGITS + 7) / 8)
+#define DETERMINED_SIZE ((NCELLS + 7) / 8)
+#define BOARD_BYTES (VALS_SIZE + DETERMINED_SIZE)
+
+#define CHECKSUM 4
+
+size_t
+snapshot_size(int n)
+{
+  return HEADER + (size_t)n * BOARD_BYTES + CHECKSUM;
+}
+
+#define ADLER_MOD 65521
+
+/* Largest number of bytes that can be summed before the sums must be
+   reduced, as in zlib. */
+#define ADLER_RUN 5552
+
+static unsigned long
+adler32(const unsigned char *buf, size_t n)
+{
+  unsigned long a = 1, b = 0;
+  while (n > 0) {
+    size_t run = n < ADLER_RUN ? n : ADLER_RUN;
+    n -= run;
+    while (run--) {
+      a += *buf++;
+      b += a;
+    }
+    a %= ADLER_MOD;
+    b %= ADLER_MOD;
+  }
+  return (b << 16) | a;
+}
+
+static void
+put32(unsigned char *p, unsigned long x)
+{
+  p[0] = x >> 24;
+  p[1] = x >> 16;
+  p[2] = x >> 8;
+  p[3] = x;
+}
+
+static unsigned long
+get32(const unsigned char *p)
+{
+  return (unsigned long)p[0] << 24 | (unsigned long)p[1] << 16
+    | (unsigned long)p[2] << 8 | p[3];
+}
+
+void
+snapshot_seal(unsigned char *buf, int details, int n)
+{
+  memcpy(buf, magic, sizeof magic);
+  buf[3] = FORMAT;
+  buf[4] = details ? DETAILS : 0;
+  buf[5] = 0;
+  buf[6] = n >> 8;
+  buf[7] = n;
+  size_t end = snapshot_size(n) - CHECKSUM;
+  put32(buf + end, adler32(buf, end));
+}
+
+/* The sets of digits are packed least significant bit first, so the
+   set of cell i starts at bit i * DIGITS. */
+
+void
+snapshot_put(unsigned char *buf, int k,
+	     const int vals[], const int determined[])
+{
+  unsigned char *p = buf + HEADER + (size_t)k * BOARD_BYTES;
+  memset(p, 0, BOARD_BYTES);
+  unsigned long acc = 0;	/* Bits not yet written */
+  int nbits = 0;
+  int i;
+  for (i = 0; i < NCELLS; i++) {
+    acc |= (unsigned long)(vals[i] & ALL) << nbits;
+    for (nbits += DIGITS; nbits >= 8; nbits -= 8) {
+      *p++ = acc;
+      acc >>= 8;
+    }
+  }
+  if (nbits > 0)
+    *p++ = acc;
+  for (i = 0; i < NCELLS; i++)
+    if (determined[i])
+      p[i / 8] |= 1 << i % 8;
+}
+
+const char *
+snapshot_open(const unsigned char *buf, size_t n,
+	      int *details, int *nboards)
+{
+  if (n < HEADER || memcmp(buf, magic, sizeof magic))
+    return "not a snapshot";
+  if (buf[3] != FORMAT)
+    return "unsupported snapshot version";
+  int k = buf[6] << 8 | buf[7];
+  if (k < 1 || n != snapshot_size(k))
+    return "snapshot is truncated";
+  size_t end = n - CHECKSUM;
+  if (get32(buf + end) != adler32(buf, end))
+    return "snapshot is corrupt";
+  *details = (buf[4] & DETAILS) != 0;
+  *nboards = k;
+  return NULL;
+}
+
+void
+snapshot_get(const unsigned char *buf, int k,
+	     int vals[], int determined[])
+{
+  const unsigned char *p = buf + HEADER + (size_t)k * BOARD_BYTES;
+  unsigned long acc = 0;	/* Bits read but not yet used */
+  int nbits = 0;
+  int i;
+  for (i = 0; i < NCELLS; i++) {
+    for (; nbits < DIGITS; nbits += 8)
+      acc |= (unsigned long)*p++ << nbits;
+    vals[i] = acc & ALL;
+    acc >>= DIGITS;
+    nbits -= DIGITS;
+  }
+  for (i = 0; i < NCELLS; i++)
+    determined[i] = (p[i / 8] >> i % 8) & 1;
+}
@@ -0,0 +1,44 @@
+/* Boards and their history as binary snapshots. */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+
+/* The extension of a file that holds a snapshot. */
+#define SNAPSHOT_EXT ".gss"
+
+/* A snapshot holds a sequence of boards, the history followed by the
+   current board.  It starts with a header giving the format version,
+   the details flag, and the number of boards.  Each board is the set
+   of digits of each cell, nine bits a cell, followed by a bitmap of
+   the determined cells.  An Adler-32 checksum of what comes before
+   ends the snapshot.  Multibyte numbers are big endian. */
+
+/* The most boards a snapshot holds. */
+#define SNAPSHOT_MAX_BOARDS 0xffff
+
+/* Returns the size in bytes of a snapshot holding n boards. */
+size_t snapshot_size(int n);
+
+/* Writes the header and checksum of a snapshot holding n boards into
+   buf, which has room for snapshot_size(n) bytes.  The boards must
+   be written first. */
+void snapshot_seal(unsigned char *buf, int details, int n);
+
+/* Writes board k of a snapshot into buf.  The arguments vals and
+   determined have NCELLS elements. */
+void snapshot_put(unsigned char *buf, int k,
+		  const int vals[], const int determined[]);
+
+/* Checks the header and checksum of the snapshot in buf of size n
+   bytes.  Sets details and the number of boards held on success.
+   Returns a non-NULL message on error. */
+const char *snapshot_open(const unsigned char *buf, size_t n,
+			  int *details, int *nboards);
+
+/* Reads board k of a snapshot checked by snapshot_open. */
+void snapshot_get(const unsigned char *buf, int k,
+		  int vals[], int determined[]);
+
+#endif
@@ -0,0 +1,324 @@
+/*
+ * Counting the solutions of a board by backtracking.
+ *
+ * Copyright (C) 2006 John D. Ramsdell
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+/*
+ * The search keeps the digits possible in each open cell as a bit
+ * set.  Placing a digit clears its bit in the cell's peers, and a
+ * peer left with one digit is placed in turn.  Before each branch,
+ * every house is checked for digits with no place, which fail, and
+ * digits with one place, which are placed.  A digit with one place is
+ * found with two masks per house: the digits seen at least once, and
+ * those seen at least twice.  The search branches on an open cell
+ * with the fewest digits possible.  Each branch works on a copy of
+ * the state, which is small, so nothing needs to be undone.
+ *
+ * The search can be split into parts to be searched separately, by
+ * branching breadth first from the top of the search tree until there
+ * are enough parts.  Each part is a board of its own.  Once the
+ * split has filled in the tables, which are read only after that, the
+ * parts may be searched by several threads at once.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "gtksudoku.h"
+#include "board.h"
+#include "solver.h"
+
+#define NPEERS (2 * (DIGITS - 1) + (SIDES - 1) * (SIDES - 1))
+#define NHOUSES (3 * DIGITS)
+
+static int peers[NCELLS][NPEERS];
+static int houses[NHOUSES][DIGITS];
+static int ready;		/* Are the tables filled in? */
+
+static void
+init_tables(void)
+{
+  if (ready)
+    return;
+  int i, j;
+  for (i = 0; i < NCELLS; i++) {
+    int row = i / DIGITS, col = i % DIGITS;
+    int square = row / SIDES * SIDES + col / SIDES;
+    int pos = row % SIDES * SIDES + col % SIDES;
+    houses[square][pos] = i;
+    houses[DIGITS + row][col] = i;
+    houses[2 * DIGITS + col][row] = i;
+    int n = 0;
+    for (j = 0; j < NCELLS; j++) {
+      int r = j / DIGITS, c = j % DIGITS;
+      if (j != i && (r == row || c == col
+		     || (r / SIDES == row / SIDES
+			 && c / SIDES == col / SIDES)))
+	peers[i][n++] = j;
+    }
+  }
+  ready = 1;
+}
+
+typedef struct {
+  uint16_t cands[NCELLS];	/* Digits possible in each open cell */
+  unsigned char digits[NCELLS];	/* Digit in each filled cell, else 0 */
+  int open;			/* Number of open cells */
+} state;
+
+/* Place digit d in cell i, and the singles that follow.  Returns zero
+   at a contradiction. */
+
+static int
+place(state *s, int i, int d)
+{
+  int stack[NCELLS][2], n = 0;
+  stack[n][0] = i;
+  stack[n][1] = d;
+  n++;
+  while (n > 0) {
+    n--;
+    i = stack[n][0];
+    d = stack[n][1];
+    int bit = 1 << (d - 1);
+    if (s->digits[i]) {
+      if (s->digits[i] != d)
+	return 0;
+      continue;
+    }
+    if (!(s->cands[i] & bit))
+      return 0;
+    s->digits[i] = d;
+    s->cands[i] = 0;
+    s->open--;
+    int k;
+    for (k = 0; k < NPEERS; k++) {
+      int j = peers[i][k];
+      if (!(s->cands[j] & bit))
+	continue;
+      int m = s->cands[j] &= ~bit;
+      if (!m)
+	return 0;
+      if (!(m & (m - 1))) {
+	stack[n][0] = j;
+	for (d = 1; !(m & 1 << (d - 1)); d++);
+	stack[n][1] = d;
+	n++;
+      }
+    }
+  }
+  return 1;
+}
+
+/* Place the digits with one place in a house.  Returns -1 at a
+   contradiction, 1 when a digit was placed, and 0 otherwise. */
+
+static int
+hidden_singles(state *s)
+{
+  int h, k, progress = 0;
+  for (h = 0; h < NHOUSES; h++) {
+    int once = 0, twice = 0, filled = 0;
+    for (k = 0; k < DIGITS; k++) {
+      int i = houses[h][k];
+      int m = s->digits[i] ? 1 << (s->digits[i] - 1) : s->cands[i];
+      if (s->digits[i])
+	filled |= m;
+      twice |= once & m;
+      once |= m;
+    }
+    if (once != ALL)
+      return -1;
+    int singles = once & ~twice & ~filled;
+    while (singles) {
+      int bit = singles & -singles, d;
+      singles &= singles - 1;
+      for (d = 1; bit != 1 << (d - 1); d++);
+      for (k = 0; k < DIGITS; k++) {
+	int i = houses[h][k];
+	if (s->cands[i] & bit) {
+	  if (!place(s, i, d))
+	    return -1;
+	  progress = 1;
+	  break;
+	}
+      }
+    }
+  }
+  return progress;
+}
+
+/* An open cell with the fewest digits possible. */
+
+static int
+branch_cell(const state *s)
+{
+  int i, best = -1, fewest = DIGITS + 1;
+  for (i = 0; i < NCELLS && fewest > 2; i++)
+    if (!s->digits[i]) {
+      int n = 0, m;
+      for (m = s->cands[i]; m; m &= m - 1)
+	n++;
+      if (n < fewest) {
+	fewest = n;
+	best = i;
+      }
+    }
+  return best;
+}
+
+/* Search for the solutions of s, calling emit with each.  Returns
+   non-zero when emit does. */
+
+static int
+search(state *s, solver_emit emit, void *data)
+{
+  int r;
+  while ((r = hidden_singles(s)) > 0);
+  if (r < 0)
+    return 0;
+  if (!s->open) {
+    char line[NCELLS];
+    int i;
+    for (i = 0; i < NCELLS; i++)
+      line[i] = '0' + s->digits[i];
+    return emit(line, data);
+  }
+  int best = branch_cell(s), d;
+  for (d = 1; d <= DIGITS; d++)
+    if (s->cands[best] & 1 << (d - 1)) {
+      state t = *s;
+      if (place(&t, best, d) && search(&t, emit, data))
+	return 1;
+    }
+  return 0;
+}
+
+/* Set up the state of the board with the sets of digits in vals, and
+   place its singles.  Returns zero at a contradiction. */
+
+static int
+start(state *s, const int vals[NCELLS])
+{
+  init_tables();
+  s->open = NCELLS;
+  int i;
+  for (i = 0; i < NCELLS; i++) {
+    s->cands[i] = vals[i] & ALL;
+    s->digits[i] = 0;
+  }
+  for (i = 0; i < NCELLS; i++) {
+    int m = s->cands[i];
+    if (!s->digits[i] && !m)
+      return 0;
+    if (!s->digits[i] && !(m & (m - 1))) {
+      int d;
+      for (d = 1; m != 1 << (d - 1); d++);
+      if (!place(s, i, d))
+	return 0;
+    }
+  }
+  return 1;
+}
+
+typedef struct {
+  int limit;
+  int count;
+  int (*solutions)[NCELLS];
+} counter;
+
+static int
+count(const char line[NCELLS], void *data)
+{
+  counter *c = data;
+  if (c->solutions && c->count < 2) {
+    int i;
+    for (i = 0; i < NCELLS; i++)
+      c->solutions[c->count][i] = line[i] - '0';
+  }
+  return ++c->count >= c->limit;
+}
+
+int
+solver_count(const int vals[NCELLS], int limit, int solutions[2][NCELLS])
+{
+  state s;
+  counter c;
+  c.limit = limit;
+  c.count = 0;
+  c.solutions = solutions;
+  if (limit > 0 && start(&s, vals))
+    search(&s, count, &c);
+  return c.count;
+}
+
+int
+solver_enumerate(const int vals[NCELLS], solver_emit emit, void *data)
+{
+  state s;
+  return start(&s, vals) && search(&s, emit, data);
+}
+
+int
+solver_split(const int vals[NCELLS], int n, int parts[][NCELLS])
+{
+  if (n < 1)
+    return 0;
+  state *q = malloc((n + DIGITS) * sizeof *q);
+  if (!q)
+    return -1;
+  int m = 0, h = 0, r, i, d;
+  if (start(&q[0], vals)) {
+    while ((r = hidden_singles(&q[0])) > 0);
+    m = r == 0;
+  }
+  /* Replace the first state with open cells by its branches, in
+     breadth first order, while they fit. */
+  while (h < m) {
+    if (!q[h].open) {
+      h++;
+      continue;
+    }
+    int best = branch_cell(&q[h]);
+    int k = 0, b;
+    for (b = q[h].cands[best]; b; b &= b - 1)
+      k++;
+    if (m - 1 + k > n)
+      break;
+    for (d = 1; d <= DIGITS; d++)
+      if (q[h].cands[best] & 1 << (d - 1)) {
+	q[m] = q[h];
+	if (place(&q[m], best, d)) {
+	  while ((r = hidden_singles(&q[m])) > 0);
+	  if (r == 0)
+	    m++;
+	}
+      }
+    m--;
+    memmove(&q[h], &q[h + 1], (m - h) * sizeof *q);
+  }
+  for (h = 0; h < m; h++)
+    for (i = 0; i < NCELLS; i++)
+      parts[h][i] = q[h].digits[i] ? 1 << (q[h].digits[i] - 1)
+	: q[h].cands[i];
+  free(q);
+  return m;
+}
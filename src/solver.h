@@ -0,0 +1,35 @@
+/* Counting the solutions of a board by backtracking. */
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+/* Counts the solutions of the board whose cells have the sets of
+   digits in vals, stopping when limit are found.  A solution has in
+   each cell one of the digits possible in it.  When solutions is not
+   NULL, the first two solutions found are stored in it, a digit to a
+   cell.  Returns the number of solutions found, which is at most
+   limit. */
+int solver_count(const int vals[NCELLS], int limit,
+		 int solutions[2][NCELLS]);
+
+/* A function given each solution found as NCELLS cell descriptors,
+   the digits of the cells in row major order.  The search stops when
+   it returns non-zero. */
+typedef int (*solver_emit)(const char line[NCELLS], void *data);
+
+/* Calls emit with each solution of the board whose cells have the
+   sets of digits in vals, passing it data.  Returns non-zero when
+   emit stopped the search. */
+int solver_enumerate(const int vals[NCELLS], solver_emit emit, void *data);
+
+/* Splits the search for the solutions of the board whose cells have
+   the sets of digits in vals into at most n parts, by branching on
+   the first cells that need it.  Each part is a board whose
+   solutions are its share of the solutions of the board, and is
+   stored as NCELLS sets of digits in parts.  Returns the number of
+   parts, which is zero when there is no solution, or -1 when out of
+   memory.  After a split, the parts may be searched by
+   solver_enumerate in several threads at once. */
+int solver_split(const int vals[NCELLS], int n, int parts[][NCELLS]);
+
+#endif
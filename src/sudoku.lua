@@ -32,6 +32,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307  USA
 
 local details = false
 
+-- Do rules assume the puzzle has a unique solution?
+
+local assume = true
+
 -- Useful constants
 
 local sides = 3
@@ -40,116 +44,105 @@ local digits2 = digits * digits
 
 -- Cells
 
-local Cell = {}
-Cell.__index = Cell
+local band, bor = bit.band, bit.bor
 
--- For digit i, cell[i] is false if i has been eliminated as a
--- possible value for the cell.
+-- The mask with just the bit for digit d.
 
-local function mk_cell()
-   local obj = {}
-   setmetatable(obj, Cell)
-   for i=1,digits do
-      obj[i] = true
-   end
-   return obj
+local bits = {}
+for d=1,digits do
+   bits[d] = bit.lshift(1, d - 1)
 end
 
-function Cell:clone()
-   local obj = {}
-   setmetatable(obj, Cell)
-   for i=1,#self do
-      obj[i] = self[i]
-   end
-   if self.determined then
-      obj.determined = true
-   end
-   return obj
-end
+-- Cells are provided by the C code.  A cell holds a mask of the
+-- digits that have not been eliminated as possible values for the
+-- cell, so cell[d] is false if d has been eliminated.  Cell is the
+-- table of cell methods, and mk_cell makes a cell in which every
+-- digit is possible.
 
-function Cell:same(other)
-   if not other then
-      return false
-   end
-   if self.determined ~= other.determined then
-      return false
-   end
-   for i=1,#self do
-      if self[i] ~= other[i] then
-         return false
-      end
-   end
-   return true
-end
+local Cell = Cell
+local mk_cell = mk_cell
 
--- Returns true when a some possible cell values have been eliminated.
+-- The methods used most by the rules, called as functions to save a
+-- method lookup.
 
-function Cell:singleton(d)
-   local e = false
-   for i=1,#self do
-      if i ~= d and self[i] then
-	 self[i] = false
-	 e = true
-      end
+local has, remove, unknowns = Cell.has, Cell.remove, Cell.unknowns
+local any, keep = Cell.any, Cell.keep
+local only_pair_present = Cell.only_pair_present
+
+function Cell:show()
+   if self.determined and self:unknowns() == 1 then
+      return tostring(self:first())
+   else
+      return "."
    end
-   return e
 end
 
-function Cell:unknowns()
-   local n = 0
-   for i=1,#self do
-      if self[i] then
-	 n = n + 1
-      end
-   end
-   return n
+-- Boards
+
+-- A board is an array of digits2 cells in row major order, so the
+-- cell at row r and column c has index (r - 1) * digits + c.  A house
+-- is a square, a row, or a column.  The houses are numbered so that
+-- houses 1 to 9 are the squares in row major order, houses 10 to 18
+-- are the rows, and houses 19 to 27 are the columns.
+
+local row_of = {}		-- The row of each cell
+local col_of = {}		-- The column of each cell
+local square_of = {}		-- The square of each cell
+
+local houses = {}		-- The cell indices in each house
+local member = {}		-- member[h][i] is true if cell i is in house h
+
+for h=1,3*digits do
+   houses[h] = {}
+   member[h] = {}
 end
 
-function Cell:first()
-   for i=1,#self do
-      if self[i] then
-	 return i
-      end
+for i=1,digits2 do
+   local r = math.floor((i - 1) / digits) + 1
+   local c = (i - 1) % digits + 1
+   local s = sides * math.floor((r - 1) / sides) + math.floor((c - 1) / sides) + 1
+   row_of[i] = r
+   col_of[i] = c
+   square_of[i] = s
+   for _, h in ipairs({s, digits + r, 2 * digits + c}) do
+      local house = houses[h]
+      house[1 + #house] = i
+      member[h][i] = true
    end
-   error("Board inconsistent", 0)
 end
 
-function Cell:only_pair_present(d1, d2)
-   if d1 == d2 then
-      return false
-   end
-   for i=1,#self do
-      if (i == d1 or i == d2) ~= self[i] then
-	 return false
-      end
-   end
-   return true
+local function square_house(row, col)
+   return square_of[(row - 1) * digits + col]
 end
 
-function Cell:val()
-   local n = 0;
-   for i=#self,1,-1 do
-      n = 2 * n
-      if self[i] then
-	 n = n + 1
-      end
-   end
-   return n
+local function row_house(row)
+   return digits + row
 end
 
-function Cell:show()
-   if self.determined and self:unknowns() == 1 then
-      return tostring(self:first())
-   else
-      return "."
-   end
+local function column_house(col)
+   return 2 * digits + col
 end
 
--- Boards
+-- The peers of a cell are the other cells in its houses.
 
--- A board is a 3*3*3*3 array of cells.  In a board[i][j][k][l]
--- reference, i is the major row, j is the major column, k is in minor
--- row, and l is the minor column.
+local peers = {}
+local houses_of = {}		-- The houses of each cell
+
+for i=1,digits2 do
+   local p = {}
+   local seen = {[i] = true}
+   local hs = {square_of[i], row_house(row_of[i]), column_house(col_of[i])}
+   for _, h in ipairs(hs) do
+      for _, j in ipairs(houses[h]) do
+	 if not seen[j] then
+	    seen[j] = true
+	    p[1 + #p] = j
+	 end
+      end
+   end
+   peers[i] = p
+   houses_of[i] = hs
+end
 
 local Board = {}
 Board.__index = Board
@@ -157,20 +150,8 @@ Board.__index = Board
 local function mk_board()
    local obj = {}
    setmetatable(obj, Board)
-   for r1=1,sides do
-      local major_row = {}
-      obj[r1] = major_row
-      for c1=1,sides do
-	 local minor_column = {}
-	 major_row[c1] = minor_column
-	 for r2=1,sides do
-	    local minor_row = {}
-	    minor_column[r2] = minor_row
-	    for c2=1,sides do
-	       minor_row[c2] = mk_cell()
-	    end
-	 end
-      end
+   for i=1,digits2 do
+      obj[i] = mk_cell()
    end
    return obj
 end
@@ -178,20 +159,8 @@ end
 function Board:clone()
    local obj = {}
    setmetatable(obj, Board)
-   for r1=1,sides do
-      local major_row = {}
-      obj[r1] = major_row
-      for c1=1,sides do
-	 local minor_column = {}
-	 major_row[c1] = minor_column
-	 for r2=1,sides do
-	    local minor_row = {}
-	    minor_column[r2] = minor_row
-	    for c2=1,sides do
-	       minor_row[c2] = self[r1][c1][r2][c2]:clone()
-	    end
-	 end
-      end
+   for i=1,digits2 do
+      obj[i] = self[i]:clone()
    end
    return obj
 end
@@ -200,402 +169,341 @@ function Board:same(other)
    if not other then
       return false
    end
-   for r1=1,sides do
-      for c1=1,sides do
-	 for r2=1,sides do
-	    for c2=1,sides do
-	       if not self[r1][c1][r2][c2]:same(other[r1][c1][r2][c2]) then
-		  return false
-	       end
-	    end
-	 end
+   for i=1,digits2 do
+      if not self[i]:same(other[i]) then
+	 return false
       end
    end
    return true
 end
 
-function Board:__tostring()
-   local s = ""
-   for r1=1,sides do
-      for r2=1,sides do
-	 for c1=1,sides do
-	    for c2=1,sides do
-	       s = s .. self[r1][c1][r2][c2]:show()
-	    end
-	 end
+-- Is every cell down to one digit?
+function Board:solved()
+   for i=1,digits2 do
+      if unknowns(self[i]) ~= 1 then
+	 return false
       end
    end
-   return s
+   return true
+end
+
+function Board:__tostring()
+   return pack_board(self, "line")
 end
 
 function Board:show()
-   local s = ""
-   for r1=1,sides do
-      for r2=1,sides do
-	 for c1=1,sides do
-	    for c2=1,sides do
-	       s = s .. self[r1][c1][r2][c2]:show()
-	    end
-	 end
-	 s = s .. "\n"
-      end
-   end
-   return s
+   return pack_board(self, "grid")
 end
 
 -- Board printing
 
-local function zero_based_index(major, minor)
-   return sides * (major - 1) + minor - 1
-end
-
-function Board:print_item(r1, c1, r2, c2)
-   local cell = self[r1][c1][r2][c2]
+function Board:print_item(i)
+   local cell = self[i]
    local val = cell:val()
    if val ~= 0 and not details and not cell.determined then
       val = -1
    end
-   set_val(zero_based_index(r1, r2), zero_based_index(c1, c2),
-	   val, not cell.determined)
+   set_val(row_of[i] - 1, col_of[i] - 1, val, not cell.determined)
 end
 
 function Board:print_all()
-   for r1=1,sides do
-      for c1=1,sides do
-	 for r2=1,sides do
-	    for c2=1,sides do
-	       self:print_item(r1, c1, r2, c2)
-	    end
-	 end
-      end
+   for i=1,digits2 do
+      self:print_item(i)
    end
 end
 
 local function print_blank_board()
-   for r1=1,sides do
-      for c1=1,sides do
-	 for r2=1,sides do
-	    for c2=1,sides do
-	       set_val(zero_based_index(r1, r2), zero_based_index(c1, c2), -1)
-	    end
-	 end
-      end
+   for i=1,digits2 do
+      set_val(row_of[i] - 1, col_of[i] - 1, -1)
    end
 end
 
--- Determine the value of a cell, and propagate the influence of that
--- determination in there is but one unknown in a square, row, or
--- column.
+-- Constraint propagation
 
-function Board:determine(r1, c1, r2, c2, d)
-   local cell = self[r1][c1][r2][c2]
-   if not cell[d] or cell.determined then
-      return false
-   end
-   cell.determined = true
-   local e = cell:singleton(d)
-   local m = 0
+-- Determining a cell eliminates its digit from the cell's peers, and
+-- an elimination may leave another cell ready to be determined.  Such
+-- cells are put on a queue, and determined in turn, rather than by
+-- recursion.  A cell is ready when it is the last undetermined cell in
+-- a house and has one possible value left.  When naked is true, any
+-- cell with one possible value left is ready, and when hidden is true,
+-- so is the only place left for a digit in a house.
 
-   -- Propagate singleton's influence in a square.
-   for rr2=1,sides do
-      for cc2=1,sides do
-	 if rr2 ~= r2 or cc2 ~= c2 then
-	    if self[r1][c1][rr2][cc2][d] then
-	       self[r1][c1][rr2][cc2][d] = false
-	       e = true
-	    end
-	 end
-	 if self[r1][c1][rr2][cc2].determined then
-	    m = m + 1
+local queue_cell = {}		-- Cells ready to be determined
+local queue_digit = {}		-- Their digits, or nil for the last one left
+local head = 1			-- Next entry to take from the queue
+local tail = 0			-- Last entry put on the queue
+local naked = false
+local hidden = false
+
+local function start(naked_singles, hidden_singles)
+   head, tail = 1, 0
+   naked, hidden = naked_singles, hidden_singles
+end
+
+local function enqueue(i, d)
+   tail = tail + 1
+   queue_cell[tail] = i
+   queue_digit[tail] = d
+end
+
+-- The only undetermined cell in house h, if there is just one.
+
+function Board:last_unknown(h)
+   local house = houses[h]
+   local last
+   for k=1,digits do
+      local i = house[k]
+      if not self[i].determined then
+	 if last then
+	    return nil
 	 end
+	 last = i
       end
    end
+   return last
+end
 
-   -- Finish off square with just one unknown.
-   if m == digits - 1 then
-      for rr2=1,sides do
-	 for cc2=1,sides do
-	    if not self[r1][c1][rr2][cc2].determined then
-	       e = self:propagate_elimination(r1, c1, rr2, cc2) or e
-	    end
+-- The only cell in house h in which d is possible, if there is just
+-- one.
+
+function Board:only_place(d, h)
+   local house = houses[h]
+   local place
+   for k=1,digits do
+      local i = house[k]
+      if has(self[i], d) then
+	 if place then
+	    return nil
 	 end
+	 place = i
       end
    end
+   return place
+end
+
+-- Queue the cells made ready by the elimination of digit d from cell i.
 
-   -- Propagate singleton's influence in a row.
-   m = 0
-   for cc1=1,sides do
-      for cc2=1,sides do
-	 if cc1 ~= c1 or cc2 ~= c2 then
-	    if self[r1][cc1][r2][cc2][d] then
-	       self[r1][cc1][r2][cc2][d] = false
-	       e = true
+function Board:eliminated(i, d)
+   local cell = self[i]
+   local hs = houses_of[i]
+   if not cell.determined and unknowns(cell) <= 1 then
+      if naked then
+	 enqueue(i)
+      else
+	 for k=1,#hs do
+	    if self:last_unknown(hs[k]) == i then
+	       enqueue(i)
+	       break
 	    end
 	 end
-	 if self[r1][cc1][r2][cc2].determined then
-	    m = m + 1
-	 end
       end
    end
-
-   -- Finish off row with just one unknown.
-   if m == digits - 1 then
-      for cc1=1,sides do
-	 for cc2=1,sides do
-	    if not self[r1][cc1][r2][cc2].determined then
-	       e = self:propagate_elimination(r1, cc1, r2, cc2) or e
-	    end
+   if hidden then
+      for k=1,#hs do
+	 local place = self:only_place(d, hs[k])
+	 if place and not self[place].determined then
+	    enqueue(place, d)
 	 end
       end
    end
+end
 
-   -- Propagate singleton's influence in a column.
-   m = 0
-   for rr1=1,sides do
-      for rr2=1,sides do
-	 if rr1 ~= r1 or rr2 ~= r2 then
-	    if self[rr1][c1][rr2][c2][d] then
-	       self[rr1][c1][rr2][c2][d] = false
-	       e = true
-	    end
-	 end
-	 if self[rr1][c1][rr2][c2].determined then
-	    m = m + 1
+-- Determine the value of cell i to be d, eliminate d from its peers,
+-- and queue the cells made ready.
+
+function Board:assign(i, d)
+   local cell = self[i]
+   if not has(cell, d) or cell.determined then
+      return false
+   end
+   cell.determined = true
+   local others = cell:val() - bits[d]
+   local e = cell:singleton(d)
+   if hidden then
+      for x=1,digits do
+	 if band(others, bits[x]) ~= 0 then
+	    self:eliminated(i, x)
 	 end
       end
    end
-
-   -- Finish off column with just one unknown.
-   if m == digits - 1 then
-      for rr1=1,sides do
-	 for rr2=1,sides do
-	    if not self[rr1][c1][rr2][c2].determined then
-	       e = self:propagate_elimination(rr1, c1, rr2, c2) or e
-	    end
-	 end
+   local p = peers[i]
+   for k=1,#p do
+      local j = p[k]
+      if remove(self[j], d) then
+	 e = true
+	 self:eliminated(j, d)
       end
    end
+   local hs = houses_of[i]
+   for k=1,#hs do		-- Finish off houses with just one unknown.
+      local last = self:last_unknown(hs[k])
+      if last and unknowns(self[last]) <= 1 then
+	 enqueue(last)
+      end
+   end
+   return e
+end
+
+-- Determine the cells on the queue until it is empty.
 
+function Board:propagate()
+   local e = false
+   while head <= tail do
+      local i, d = queue_cell[head], queue_digit[head]
+      head = head + 1
+      local cell = self[i]
+      if not cell.determined then
+	 e = self:assign(i, d or cell:first()) or e
+      end
+   end
    return e
 end
 
+-- Determine the value of a cell, and propagate the influence of that
+-- determination in there is but one unknown in a square, row, or
+-- column.
+
+function Board:determine(i, d)
+   start(false, false)
+   local e = self:assign(i, d)
+   return self:propagate() or e
+end
+
 -- Propagate the influence of eliminating a possible value by seeing
 -- if the elimination determines the value in a cell.
 
-function Board:propagate_elimination(r1, c1, r2, c2)
-   local cell = self[r1][c1][r2][c2]
-   if cell:unknowns() > 1 or cell.determined then
+function Board:propagate_elimination(i)
+   local cell = self[i]
+   if unknowns(cell) > 1 or cell.determined then
       return false		-- Cell is not a singleton or is
    end				-- determined, so bail out now.
-   return self:determine(r1, c1, r2, c2, cell:first())
+   return self:determine(i, cell:first())
 end
 
 -- Reading puzzles from strings
 
-local function strip_string(s)
-   return s:gsub("[^.1-9]", "")  -- Flush separators and other characters
-end
+-- A puzzle read as a line of clues has the clues determined and the
+-- clues eliminated from their peers, so all that is left is to
+-- determine the cells that are last unknown in a house.
 
-local function mk_digit_translator()
-   local pattern = "123456789"
-   local obj = {}
-   for i=1,pattern:len() do
-      obj[pattern:byte(i)] = i
+function Board:finish_houses()
+   start(false, false)
+   for h=1,#houses do
+      local last = self:last_unknown(h)
+      if last and unknowns(self[last]) <= 1 then
+	 enqueue(last)
+      end
    end
-   return obj
+   return self:propagate()
 end
 
-local digit_translator = mk_digit_translator()
-
 local function board(s)
-   local t = strip_string(s)
-   if t:len() ~= digits2 then
-      local msg = "bad input: expected " .. digits2 .. " items but found "
-      error(msg .. t:len() .. " in \n" .. s, 0)
-   end
-   local b = mk_board()
-   local i = 0
-   for r1=1,sides do
-      for r2=1,sides do
-	 for c1=1,sides do
-	    for c2=1,sides do
-	       i = i + 1
-	       local c = t:byte(i)
-	       local d = digit_translator[c]
-	       if d then
-		  b[r1][c1][r2][c2]:singleton(d)
-		  b:determine(r1, c1, r2, c2, d)
-	       end
-	    end
-	 end
-      end
+   local b, form = unpack_board(s)
+   setmetatable(b, Board)
+   if form == "line" then
+      b:finish_houses()
    end
    return b
 end
 
--- Convert a row or column coordinate into a cell index pair.
-
-local function spread(index)
-   if index < 1 or index > digits then
-      error("Bad index number " .. index, 0)
-   else
-      local i1 = math.ceil(index / sides)
-      local i2 = (index - 1) % sides + 1
-      return i1, i2
-   end
-end
-
 -- Strategies
 
 -- Each return a boolean value which is true if the rule eliminated
 -- some possible cell values.  These functions may optionally return a
 -- second value, a message string.
 
-function Board:propagate_all_singletons()
-   local e = false
-   repeat
-      local f = false
-      for r1=1,sides do
-	 for r2=1,sides do
-	    for c1=1,sides do
-	       for c2=1,sides do
-		  f = self:propagate_elimination(r1, c1, r2, c2) or f
-	       end
-	    end
-	 end
-      end
-      if f then
-	 e = true
-      else
-	 return e
-      end
-   until false
-end
-
--- The location of digit d is determined if there is only one place it
--- occurs in the square at (row, col).  The coordinates specify some
--- cell within the targeted square.
+-- Queue every undetermined cell with one possible value left.
 
-function Board:one_place_in_square(d, row, col)
-   local r1 = spread(row)
-   local c1 = spread(col)
-   local e = false
-   local m = 0
-   for r2=1,sides do
-      for c2=1,sides do
-	 if self[r1][c1][r2][c2][d] then
-	    m = m + 1
-	 end
+function Board:queue_naked_singles()
+   for i=1,digits2 do
+      local cell = self[i]
+      if not cell.determined and unknowns(cell) <= 1 then
+	 enqueue(i)
       end
    end
-   if m == 1 then
-      for r2=1,sides do
-	 for c2=1,sides do
-	    if self[r1][c1][r2][c2][d] then
-	       e = self:determine(r1, c1, r2, c2, d) or e
-	    end
-	 end
-      end
-   end
-   return e
 end
 
-function Board:one_place_in_all_squares()
-   local e = false
-   for d=1,digits do
-      for r1=1,sides do
-	 for c1=1,sides do
-	    e = self:one_place_in_square(d, r1 * sides, c1 * sides) or e
-	 end
-      end
-   end
-   return e
+function Board:propagate_all_singletons()
+   start(true, false)
+   self:queue_naked_singles()
+   return self:propagate()
 end
 
 -- The location of digit d is determined if there is only one place it
--- occurs in the given row.
+-- occurs in house h.
 
-function Board:one_place_in_row(d, row)
-   local r1, r2 = spread(row)
+function Board:one_place_in_house(d, h)
+   local house = houses[h]
    local e = false
    local m = 0
-   for c1=1,sides do
-      for c2=1,sides do
-	 if self[r1][c1][r2][c2][d] then
-	    m = m + 1
-	 end
+   for k=1,digits do
+      if has(self[house[k]], d) then
+	 m = m + 1
       end
    end
    if m == 1 then
-      for c1=1,sides do
-	 for c2=1,sides do
-	    if self[r1][c1][r2][c2][d] then
-	       e = self:determine(r1, c1, r2, c2, d) or e
-	    end
+      for k=1,digits do
+	 if has(self[house[k]], d) then
+	    e = self:determine(house[k], d) or e
 	 end
       end
    end
    return e
 end
 
-function Board:one_place_in_all_rows()
-   local e = false
-   for d=1,digits do
-      for row=1,digits do
-	 e = self:one_place_in_row(d, row) or e
-      end
-   end
-   return e
+-- The coordinates specify some cell within the targeted square.
+
+function Board:one_place_in_square(d, row, col)
+   return self:one_place_in_house(d, square_house(row, col))
 end
 
--- The location of digit d is determined if there is only one place it
--- occurs in the given column.
+function Board:one_place_in_row(d, row)
+   return self:one_place_in_house(d, row_house(row))
+end
 
 function Board:one_place_in_column(d, col)
-   local c1, c2 = spread(col)
-   local e = false
-   local m = 0
-   for r1=1,sides do
-      for r2=1,sides do
-	 if self[r1][c1][r2][c2][d] then
-	    m = m + 1
-	 end
-      end
-   end
-   if m == 1 then
-      for r1=1,sides do
-	 for r2=1,sides do
-	    if self[r1][c1][r2][c2][d] then
-	       e = self:determine(r1, c1, r2, c2, d) or e
-	    end
-	 end
-      end
-   end
-   return e
+   return self:one_place_in_house(d, column_house(col))
 end
 
-function Board:one_place_in_all_columns()
-   local e = false
-   for d=1,digits do
-      for col=1,digits do
-	 e = self:one_place_in_column(d, col) or e
+-- Apply all the one place rules until none apply.  Each house is
+-- searched once for digits with only one place, and after that, only
+-- the houses of cells from which a digit is eliminated.
+
+function Board:simp()
+   start(true, true)
+   self:queue_naked_singles()
+   for h=1,#houses do
+      for d=1,digits do
+	 local place = self:only_place(d, h)
+	 if place and not self[place].determined then
+	    enqueue(place, d)
+	 end
       end
    end
-   return e
+   return self:propagate()
 end
 
--- Apply all the one place rules until none apply.
+-- If digit d is only in the cells of house a that are also in house
+-- b, it cannot be in the other cells of house b.
 
-function Board:simp()
+function Board:confined(d, a, b)
+   local house = houses[a]
+   local inside = member[b]
+   for k=1,digits do
+      local i = house[k]
+      if not inside[i] and has(self[i], d) then
+	 return false		-- Rule not applicable
+      end
+   end
    local e = false
-   local f = false
-   repeat
-      f = self:propagate_all_singletons()
-	 or self:one_place_in_all_squares()
-	 or self:one_place_in_all_rows()
-	 or self:one_place_in_all_columns()
-      e = e or f
-   until not f
+   house = houses[b]
+   inside = member[a]
+   for k=1,digits do
+      local i = house[k]
+      if not inside[i] then
+	 e = remove(self[i], d) or e
+      end
+   end
    return e
 end
 
@@ -603,334 +511,354 @@ end
 -- same row in other squares.
 
 function Board:one_row_in_square(d, row, col)
-   local e = false
-   local r1, r2 = spread(row)
-   local c1 = spread(col)
-   for rr2=1,sides do
-      if rr2 ~= r2 then
-	 for c2=1,sides do
-	    if self[r1][c1][rr2][c2][d] then
-	       return e		-- Rule not applicable
-	    end
-	 end
-      end
-   end
-   for cc1=1,sides do
-      if cc1 ~= c1 then
-	 for c2=1,sides do
-	    if self[r1][cc1][r2][c2][d] then
-	       self[r1][cc1][r2][c2][d] = false
-	       e = true
-	    end
-	 end
-      end
-   end
-   return e
+   return self:confined(d, square_house(row, col), row_house(row))
 end
 
 -- If digit d is only in one column in a square, it cannot be in that
 -- same column in other squares.
 
 function Board:one_column_in_square(d, row, col)
-   local e = false
-   local r1 = spread(row)
-   local c1, c2 = spread(col)
-   for cc2=1,sides do
-      if cc2 ~= c2 then
-	 for r2=1,sides do
-	    if self[r1][c1][r2][cc2][d] then
-	       return e		-- Rule not applicable
-	    end
-	 end
-      end
-   end
-   for rr1=1,sides do
-      if rr1 ~= r1 then
-	 for r2=1,sides do
-	    if self[rr1][c1][r2][c2][d] then
-	       self[rr1][c1][r2][c2][d] = false
-	       e = true
-	    end
-	 end
-      end
-   end
-   return e
+   return self:confined(d, square_house(row, col), column_house(col))
 end
 
 -- If digit d is only in one square of a row, it cannot be in other
 -- rows in that square.
 
 function Board:one_square_for_row(d, row, col)
-   local e = false
-   local r1, r2 = spread(row)
-   local c1 = spread(col)
-   for cc1=1,sides do
-      if cc1 ~= c1 then
-	 for c2=1,sides do
-	    if self[r1][cc1][r2][c2][d] then
-	       return e		-- Rule not applicable
-	    end
-	 end
-      end
-   end
-   for rr2=1,sides do
-      if rr2 ~= r2 then
-	 for c2=1,sides do
-	    if self[r1][c1][rr2][c2][d] then
-	       self[r1][c1][rr2][c2][d] = false
-	       e = true
-	    end
-	 end
-      end
-   end
-   return e
+   return self:confined(d, row_house(row), square_house(row, col))
 end
 
 -- If digit d is only in one square of a column, it cannot be in other
 -- columns in that square.
 
 function Board:one_square_for_column(d, row, col)
-   local e = false
-   local r1 = spread(row)
-   local c1, c2 = spread(col)
-   for rr1=1,sides do
-      if rr1 ~= r1 then
-	 for r2=1,sides do
-	    if self[rr1][c1][r2][c2][d] then
-	       return e		-- Rule not applicable
-	    end
-	 end
-      end
-   end
-   for cc2=1,sides do
-      if cc2 ~= c2 then
-	 for r2=1,sides do
-	    if self[r1][c1][r2][cc2][d] then
-	       self[r1][c1][r2][cc2][d] = false
-	       e = true
-	    end
-	 end
-      end
-   end
-   return e
+   return self:confined(d, column_house(col), square_house(row, col))
 end
 
--- If there are only two places for d1 and d2 in a square, only d1 and
+-- If there are only two places for d1 and d2 in house h, only d1 and
 -- d2 can appear in those places.
 
-function Board:two_places_for_pair_in_square(d1, d2, row, col)
+function Board:two_places_for_pair(d1, d2, h)
    local e = false
-   local r1 = spread(row)
-   local c1 = spread(col)
    if d1 == d2 then
       return e			-- Bad input
    end
+   local house = houses[h]
+   local pair = bor(bits[d1], bits[d2])
    local m = 0
-   for r2=1,sides do
-      for c2=1,sides do
-	 if self[r1][c1][r2][c2][d1] or self[r1][c1][r2][c2][d2] then
-	    m = m + 1
-	 end
+   for k=1,digits do
+      if any(self[house[k]], pair) then
+	 m = m + 1
       end
    end
    if m ~= 2 then
       return e			-- Rule not applicable
    end
-   for r2=1,sides do
-      for c2=1,sides do
-	 if self[r1][c1][r2][c2][d1] or self[r1][c1][r2][c2][d2] then
-	    for d=1,digits do
-	       if d ~= d1 and d ~= d2 and self[r1][c1][r2][c2][d] then
-		  self[r1][c1][r2][c2][d] = false
-		  e = true
-	       end
-	    end
-	 end
-      end
+   for k=1,digits do
+      e = keep(self[house[k]], pair) or e
    end
    return e
 end
 
--- If there are only two places for d1 and d2 in a row, only d1 and
--- d2 can appear in those places.
+function Board:two_places_for_pair_in_square(d1, d2, row, col)
+   return self:two_places_for_pair(d1, d2, square_house(row, col))
+end
 
 function Board:two_places_for_pair_in_row(d1, d2, row)
-   local e = false
-   local r1, r2 = spread(row)
-   if d1 == d2 then
-      return e			-- Bad input
-   end
-   local m = 0
-   for c1=1,sides do
-      for c2=1,sides do
-	 if self[r1][c1][r2][c2][d1] or self[r1][c1][r2][c2][d2] then
-	    m = m + 1
-	 end
-      end
-   end
-   if m ~= 2 then
-      return e			-- Rule not applicable
-   end
-   for c1=1,sides do
-      for c2=1,sides do
-	 if self[r1][c1][r2][c2][d1] or self[r1][c1][r2][c2][d2] then
-	    for d=1,digits do
-	       if d ~= d1 and d ~= d2 and self[r1][c1][r2][c2][d] then
-		  self[r1][c1][r2][c2][d] = false
-		  e = true
-	       end
-	    end
-	 end
-      end
-   end
-   return e
+   return self:two_places_for_pair(d1, d2, row_house(row))
 end
 
--- If there are only two places for d1 and d2 in a column, only d1 and
--- d2 can appear in those places.
-
 function Board:two_places_for_pair_in_column(d1, d2, col)
+   return self:two_places_for_pair(d1, d2, column_house(col))
+end
+
+-- If two cells in house h contain only d1 and d2, other occurrences
+-- of the digits in the house are eliminated.
+
+function Board:same_pair(d1, d2, h)
    local e = false
-   local c1, c2 = spread(col)
    if d1 == d2 then
       return e			-- Bad input
    end
+   local house = houses[h]
    local m = 0
-   for r1=1,sides do
-      for r2=1,sides do
-	 if self[r1][c1][r2][c2][d1] or self[r1][c1][r2][c2][d2] then
-	    m = m + 1
-	 end
+   for k=1,digits do
+      if only_pair_present(self[house[k]], d1, d2) then
+	 m = m + 1
       end
    end
    if m ~= 2 then
       return e			-- Rule not applicable
    end
-   for r1=1,sides do
-      for r2=1,sides do
-	 if self[r1][c1][r2][c2][d1] or self[r1][c1][r2][c2][d2] then
-	    for d=1,digits do
-	       if d ~= d1 and d ~= d2 and self[r1][c1][r2][c2][d] then
-		  self[r1][c1][r2][c2][d] = false
-		  e = true
-	       end
-	    end
-	 end
+   for k=1,digits do
+      local cell = self[house[k]]
+      if not only_pair_present(cell, d1, d2) then
+	 e = remove(cell, d1) or e
+	 e = remove(cell, d2) or e
       end
    end
    return e
 end
 
 function Board:same_pair_in_square(d1, d2, row, col)
-   local e = false
-   local r1 = spread(row)
-   local c1 = spread(col)
-   if d1 == d2 then
-      return e			-- Bad input
-   end
-   local m = 0
-   for r2=1,sides do
-      for c2=1,sides do
-	 if self[r1][c1][r2][c2]:only_pair_present(d1, d2) then
-	    m = m + 1
-	 end
-      end
-   end
-   if m ~= 2 then
-      return e			-- Rule not applicable
+   return self:same_pair(d1, d2, square_house(row, col))
+end
+
+function Board:same_pair_in_row(d1, d2, row)
+   return self:same_pair(d1, d2, row_house(row))
+end
+
+function Board:same_pair_in_column(d1, d2, col)
+   return self:same_pair(d1, d2, column_house(col))
+end
+
+-- Rules for triples and quads are done in C, as a rule for a subset
+-- of digits in house h.  If there are only as many places for the
+-- digits as digits, only those digits can appear in those places.  If
+-- as many cells as digits contain only digits in the subset, other
+-- occurrences of the digits in the house are eliminated.
+
+function Board:places_for_subset(h, ...)
+   return hidden_subset(self, h, ...)
+end
+
+function Board:same_subset(h, ...)
+   return naked_subset(self, h, ...)
+end
+
+-- A description of house h.
+
+local function house_name(h)
+   if h <= digits then
+      local i = houses[h][1]
+      return "square at (" .. row_of[i] .. ", " .. col_of[i] .. ")"
+   elseif h <= 2 * digits then
+      return "row at " .. h - digits
+   else
+      return "column at " .. h - 2 * digits
    end
-   for r2=1,sides do
-      for c2=1,sides do
-	 if not self[r1][c1][r2][c2]:only_pair_present(d1, d2) then
-	    if self[r1][c1][r2][c2][d1] then
-	       self[r1][c1][r2][c2][d1] = false
-	       e = true
-	    end
-	    if self[r1][c1][r2][c2][d2] then
-	       self[r1][c1][r2][c2][d2] = false
-	       e = true
-	    end
-	 end
-      end
+end
+
+local subset_names = {
+   [3] = {naked = "same triple", hidden = "three places for triple"},
+   [4] = {naked = "same quad", hidden = "four places for quad"}
+}
+
+-- Fish are also done in C.  If the places for d in the rows of the
+-- base are in just as many columns, d is eliminated from the rest of
+-- those columns, and the same goes for columns in place of rows.  A
+-- finned fish has extra places for d in the base, all in one square,
+-- and d is eliminated only from the places in that square.
+
+function Board:fish(d, kind, finned, ...)
+   return fish(self, d, kind, finned, ...)
+end
+
+local fish_names = {[2] = "X-Wing", [3] = "Swordfish", [4] = "Jellyfish"}
+
+-- A description of the fish found by find_fish.
+
+local function fish_name(n, finned, kind, d, ...)
+   local name = fish_names[n] .. " for " .. d .. " in " .. kind .. "s "
+      .. table.concat({...}, ", ")
+   if finned then
+      return "finned " .. name
+   else
+      return name
    end
-   return e
 end
 
-function Board:same_pair_in_row(d1, d2, row)
-   local e = false
-   local r1, r2 = spread(row)
-   if d1 == d2 then
-      return e			-- Bad input
+-- Wings are done in C as well.  An XY-Wing is a pivot cell with only
+-- x and y possible that sees two pincers, one with only x and z, and
+-- the other with only y and z.  One pincer holds z, so z is
+-- eliminated from cells that see both.  An XYZ-Wing has a pivot with
+-- x, y, and z, and z is eliminated from cells that see all three.  A
+-- W-Wing is two cells that do not see each other with only x and y
+-- possible, where x has just two places in some house, one seen by
+-- each cell.  One of the cells holds y, so y is eliminated from cells
+-- that see both.
+
+local function cell_at(row, col)
+   return (row - 1) * digits + col
+end
+
+local function cell_name(i)
+   return "(" .. row_of[i] .. ", " .. col_of[i] .. ")"
+end
+
+function Board:xy_wing(p, a, b)
+   return xy_wing(self, p, a, b)
+end
+
+function Board:xyz_wing(p, a, b)
+   return xyz_wing(self, p, a, b)
+end
+
+function Board:w_wing(d, a, b)
+   return w_wing(self, d, a, b)
+end
+
+-- Chains are done in C too.  Simple coloring follows the houses with
+-- just two places for a digit, giving the places alternating colors,
+-- so all places of one color hold the digit.  A chain alternates
+-- between strong links, where one of two candidates must hold, and
+-- weak links, where both cannot.  It starts and ends with strong
+-- links, so one of its ends holds, and candidates that cannot hold
+-- with either end are eliminated.  An X-Chain uses only one digit.
+
+function Board:coloring(d, i)
+   return coloring(self, d, i)
+end
+
+-- A description of the coloring found by find_coloring.
+
+local function coloring_name(d, i)
+   return "simple coloring for " .. d .. " from " .. cell_name(i)
+end
+
+-- A step by step description of the chain found by find_chain, given
+-- the cell and digit of each candidate in it.
+
+local function chain_name(...)
+   local chain = {...}
+   local steps = {}
+   local single = true
+   for k=1,#chain,2 do
+      local is = (k + 1) % 4 == 0 and " is " or " is not "
+      steps[1 + #steps] = cell_name(chain[k]) .. is .. chain[k + 1]
+      single = single and chain[k + 1] == chain[2]
    end
-   local m = 0
-   for c1=1,sides do
-      for c2=1,sides do
-	 if self[r1][c1][r2][c2]:only_pair_present(d1, d2) then
-	    m = m + 1
-	 end
+   local name = single and "X-Chain for " .. chain[2] or "AIC"
+   return name .. ": " .. table.concat(steps, ", so ")
+end
+
+-- Almost locked sets are n cells in a house with n + 1 digits
+-- possible among them.  The rules about them are the costliest, so
+-- all gives up on them after als_budget steps.  The commands for
+-- them have no such limit.
+
+local als_budget = 5000
+
+-- A description of the rule found by find_als.
+
+local function als_name(sets, x, y, zs)
+   local names = {}
+   for k, set in ipairs(sets) do
+      local cells = {}
+      for _, i in ipairs(set) do
+	 cells[1 + #cells] = cell_name(i)
       end
+      names[k] = "{" .. table.concat(cells, " ") .. "}"
    end
-   if m ~= 2 then
-      return e			-- Rule not applicable
-   end
-   for c1=1,sides do
-      for c2=1,sides do
-	 if not self[r1][c1][r2][c2]:only_pair_present(d1, d2) then
-	    if self[r1][c1][r2][c2][d1] then
-	       self[r1][c1][r2][c2][d1] = false
-	       e = true
-	    end
-	    if self[r1][c1][r2][c2][d2] then
-	       self[r1][c1][r2][c2][d2] = false
-	       e = true
-	    end
-	 end
-      end
+   local z = " eliminates " .. table.concat(zs, " ")
+   if y then
+      return "ALS-XY-Wing " .. names[1] .. " and " .. names[2]
+	 .. " with " .. names[3] .. " on " .. x .. " and " .. y .. z
+   else
+      return "ALS-XZ " .. names[1] .. " and " .. names[2]
+	 .. " on " .. x .. z
    end
-   return e
 end
 
-function Board:same_pair_in_column(d1, d2, col)
-   local e = false
-   local c1, c2 = spread(col)
-   if d1 == d2 then
-      return e			-- Bad input
+-- The pattern overlay method is in C.  A template of a digit is a
+-- set of nine cells, one in each row, column, and square, in which it
+-- could be placed.  A digit is eliminated from the cells in no
+-- template that agrees with the board.
+
+function Board:pattern_overlay(d)
+   return pattern_overlay(self, d)
+end
+
+-- A description of the cells from which templates eliminated d.
+
+local function overlay_name(d, ...)
+   local cells = {}
+   for k, i in ipairs({...}) do
+      cells[k] = cell_name(i)
    end
-   local m = 0
-   for r1=1,sides do
-      for r2=1,sides do
-	 if self[r1][c1][r2][c2]:only_pair_present(d1, d2) then
-	    m = m + 1
-	 end
-      end
+   return "templates for " .. d .. " eliminate it from "
+      .. table.concat(cells, " ")
+end
+
+-- Nishio is in C.  It tries a digit in a cell, and determines naked
+-- and hidden singles until it is stuck or reaches a contradiction, in
+-- which case the digit is eliminated.  The forcing chain to the
+-- contradiction is a list of cells and digits, the first being the
+-- digit tried.
+
+function Board:nishio(i, d)
+   return nishio(self, i, d)
+end
+
+-- A step by step description of a forcing chain, and the
+-- contradiction it reaches: a cell with no digit left, or a digit
+-- with no place in a house.
+
+local function nishio_name(chain, kind, where, d)
+   local steps = {}
+   for k=1,#chain,2 do
+      steps[1 + #steps] = cell_name(chain[k]) .. " is " .. chain[k + 1]
    end
-   if m ~= 2 then
-      return e			-- Rule not applicable
+   if kind == "cell" then
+      steps[1 + #steps] = cell_name(where) .. " has no digit left"
+   else
+      steps[1 + #steps] =
+	 d .. " has no place in the " .. house_name(where)
    end
-   for r1=1,sides do
-      for r2=1,sides do
-	 if not self[r1][c1][r2][c2]:only_pair_present(d1, d2) then
-	    if self[r1][c1][r2][c2][d1] then
-	       self[r1][c1][r2][c2][d1] = false
-	       e = true
-	    end
-	    if self[r1][c1][r2][c2][d2] then
-	       self[r1][c1][r2][c2][d2] = false
-	       e = true
-	    end
-	 end
-      end
+   return "Nishio: if " .. table.concat(steps, ", so ") .. ", so "
+      .. cell_name(chain[1]) .. " is not " .. chain[2]
+end
+
+-- Rules that assume the puzzle has a unique solution are also in C.
+-- A unique rectangle is four cells at the corners of a rectangle in
+-- two squares that could all hold the same two digits.  If they held
+-- only those digits, they could be swapped to give a second solution,
+-- so some corner holds another digit.  BUG+1 is a board on which every
+-- undetermined cell has two digits possible but one, which has three.
+-- Without the extra digit the board would have two solutions.
+
+function Board:unique_rectangle(a, d)
+   return unique_rectangle(self, a, d)
+end
+
+local function ur_name(type, a, d)
+   return "unique rectangle type " .. type .. " at " .. cell_name(a)
+      .. " and " .. cell_name(d)
+end
+
+local function bug_name(d, i)
+   return "BUG+1 puts " .. d .. " at " .. cell_name(i)
+end
+
+-- A description of the wing found by find_wing.
+
+local function wing_name(kind, d, a, b, c)
+   if kind == "w" then
+      return "W-Wing at " .. cell_name(a) .. " and " .. cell_name(b)
+	 .. " linked by " .. d
+   else
+      return string.upper(kind) .. "-Wing at " .. cell_name(a)
+	 .. " with " .. cell_name(b) .. " and " .. cell_name(c)
    end
-   return e
 end
 
+-- The difficulty of the rule all applied last: 1 for singles, 2 for
+-- the rules relating a square to a row or column, 3 for pairs, 4 for
+-- triples and quads, 5 for fish, 6 for finned fish, 7 for wings, 8 for
+-- rules that assume a unique solution, 9 for simple coloring, 10 for
+-- X-Chains, 11 for other chains, 12 for almost locked sets, 13 for
+-- templates, and 14 for Nishio.
+local level = 0
+
 -- Try all rules.
 function Board:all()
+   level = 1
    local e = self:simp()
    if e then
       return e, "simp"
    end
 
+   level = 2
    for d=1,digits do
       for row=1,digits do
 	 for col=1,digits do
@@ -958,6 +886,7 @@ function Board:all()
       end
    end
 
+   level = 3
    for d1=1,digits do
       for d2=1,digits do
 	 if d1 ~= d2 then
@@ -996,95 +925,163 @@ function Board:all()
 	 end
       end
    end
+
+   level = 4
+   for n=3,4 do
+      local subset_kind, h = find_subset(self, n)
+      if subset_kind then
+	 return true,
+	    subset_names[n][subset_kind] .. " in " .. house_name(h)
+      end
+   end
+
+   for _, finned in ipairs({false, true}) do
+      level = finned and 6 or 5
+      for n=2,4 do
+	 local fish_found = {find_fish(self, n, finned)}
+	 if fish_found[1] then
+	    return true, fish_name(n, finned, unpack(fish_found))
+	 end
+      end
+   end
+
+   level = 7
+   for _, kind in ipairs({"xy", "xyz", "w"}) do
+      local wing_found = {find_wing(self, kind)}
+      if wing_found[1] then
+	 return true, wing_name(kind, unpack(wing_found))
+      end
+   end
+
+   if assume then
+      level = 8
+      local ur_found = {find_unique_rectangle(self)}
+      if ur_found[1] then
+	 return true, ur_name(unpack(ur_found))
+      end
+      local bug_d, bug_i = bug_plus_one(self)
+      if bug_d then
+	 return true, bug_name(bug_d, bug_i)
+      end
+   end
+
+   level = 9
+   local color_d, color_i = find_coloring(self)
+   if color_d then
+      return true, coloring_name(color_d, color_i)
+   end
+
+   level = 10
+   for chain_d=1,digits do
+      local xchain_found = {find_chain(self, chain_d)}
+      if xchain_found[1] then
+	 return true, chain_name(unpack(xchain_found))
+      end
+   end
+
+   level = 11
+   local aic_found = {find_chain(self)}
+   if aic_found[1] then
+      return true, chain_name(unpack(aic_found))
+   end
+
+   level = 12
+   for _, als_kind in ipairs({"xz", "xy"}) do
+      local sets, x, y, zs = find_als(self, als_kind, als_budget)
+      if sets then
+	 return true, als_name(sets, x, y, zs)
+      end
+   end
+
+   level = 13
+   local overlay_found = {find_pattern_overlay(self)}
+   if overlay_found[1] then
+      return true, overlay_name(unpack(overlay_found))
+   end
+
+   level = 14
+   local nishio_found = {find_nishio(self)}
+   if nishio_found[1] then
+      return true, nishio_name(unpack(nishio_found))
+   end
    return e
 end
 
+-- The number of undetermined cells in house h in which d is possible,
+-- and the last such cell.
+
+function Board:places(d, h)
+   local house = houses[h]
+   local m = 0
+   local place
+   for k=1,digits do
+      local cell = self[house[k]]
+      if not cell.determined and has(cell, d) then
+	 m = m + 1
+	 place = house[k]
+      end
+   end
+   return m, place
+end
+
 function Board:hint()
-   for r1=1,sides do		-- Look for one place in square hint
-      for c1=1,sides do
-	 for d=1,digits do
-	    local m = 0
-	    for r2=1,sides do
-	       for c2=1,sides do
-		  local cell = self[r1][c1][r2][c2]
-		  if not cell.determined and cell[d] then
-		     m = m + 1
-		  end
-	       end
-	    end
-	    if m == 1 then
-	       for r2=1,sides do
-		  for c2=1,sides do
-		     local cell = self[r1][c1][r2][c2]
-		     if not cell.determined and cell[d] then
-			local row = (r1 - 1) * sides + r2
-			local col = (c1 - 1) * sides + c2
-			local msg = "look at " .. d .. " in ("
-			return false, msg .. row .. ", " .. col .. ")"
-		     end
-		  end
-	       end
-	    end
+   for s=1,digits do		-- Look for one place in square hint
+      for d=1,digits do
+	 local m, i = self:places(d, s)
+	 if m == 1 then
+	    local msg = "look at " .. d .. " in ("
+	    return false, msg .. row_of[i] .. ", " .. col_of[i] .. ")"
 	 end
       end
    end
 
-   for r1=1,sides do		-- Look for one place in row hint
-      for r2=1,sides do
-	 for d=1,digits do
-	    local m = 0
-	    for c1=1,sides do
-	       for c2=1,sides do
-		  local cell = self[r1][c1][r2][c2]
-		  if not cell.determined and cell[d] then
-		     m = m + 1
-		  end
-	       end
-	    end
-	    if m == 1 then
-	       local row = (r1 - 1) * sides + r2
-	       return false, "look at " .. d .. " in row " .. row
-	    end
+   for row=1,digits do		-- Look for one place in row hint
+      for d=1,digits do
+	 if self:places(d, row_house(row)) == 1 then
+	    return false, "look at " .. d .. " in row " .. row
 	 end
       end
    end
 
-   for c1=1,sides do		-- Look for one place in column hint
-      for c2=1,sides do
-	 for d=1,digits do
-	    local m = 0
-	    for r1=1,sides do
-	       for r2=1,sides do
-		  local cell = self[r1][c1][r2][c2]
-		  if not cell.determined and cell[d] then
-		     m = m + 1
-		  end
-	       end
-	    end
-	    if m == 1 then
-	       local col = (c1 - 1) * sides + c2
-	       return false, "look at " .. d .. " in column " .. col
-	    end
+   for col=1,digits do		-- Look for one place in column hint
+      for d=1,digits do
+	 if self:places(d, column_house(col)) == 1 then
+	    return false, "look at " .. d .. " in column " .. col
 	 end
       end
    end
 
-   for r1=1,sides do	-- Look for undetermined cell with one unknown
-      for c1=1,sides do
-	 for r2=1,sides do
-	    for c2=1,sides do
-	       local cell = self[r1][c1][r2][c2]
-	       if not cell.determined and cell:unknowns() == 1 then
-		  local row = (r1 - 1) * sides + r2
-		  local col = (c1 - 1) * sides + c2
-		  local msg = "look at " .. cell:first() .. " in ("
-		  return false, msg .. row .. ", " .. col .. ")"
-	       end
-	    end
+   for s=1,digits do	-- Look for undetermined cell with one unknown
+      local house = houses[s]
+      for k=1,digits do
+	 local i = house[k]
+	 local cell = self[i]
+	 if not cell.determined and unknowns(cell) == 1 then
+	    local msg = "look at " .. cell:first() .. " in ("
+	    return false, msg .. row_of[i] .. ", " .. col_of[i] .. ")"
+	 end
+      end
+   end
+
+   local copy = self:clone()	-- Look for a fish without using it
+   for _, finned in ipairs({false, true}) do
+      for n=2,4 do
+	 local found = {find_fish(copy, n, finned)}
+	 if found[1] then
+	    return false, "look for " .. fish_name(n, finned, unpack(found))
 	 end
       end
    end
 
+   local d, i = find_coloring(copy)
+   if d then
+      return false, "look for " .. coloring_name(d, i)
+   end
+   local found = {find_chain(copy)}
+   if found[1] then
+      return false, "look for " .. chain_name(unpack(found))
+   end
+
    return false, "No hint available"
 end
 
@@ -1140,20 +1137,59 @@ end
 
 -- Load a puzzle from a string.
 
+local current			-- The number of the puzzle from a file
+local loaded			-- The board as loaded
+
 function load(s)
    it = board(s)
    history = {}
+   current = nil
+   loaded = it:clone()
    return it:print_all()
 end
 
-function save()
+function save(cands)
+   if it then
+      return pack_board(it, cands and "candidates" or "grid")
+   else
+      error("nothing to save", 0)
+   end
+end
+
+-- The board with the digits still possible in each cell, for finding
+-- its solutions.
+
+function candidates()
+   if it then
+      return pack_board(it, "candidates")
+   else
+      error("no board", 0)
+   end
+end
+
+-- Save and restore the board, its history, and the details flag as a
+-- binary snapshot.
+
+function save_snapshot()
    if it then
-      return it:show()
+      return pack_snapshot(details, history, it)
    else
       error("nothing to save", 0)
    end
 end
 
+function load_snapshot(s)
+   local b, h, d = unpack_snapshot(s)
+   setmetatable(b, Board)
+   for k=1,#h do
+      setmetatable(h[k], Board)
+   end
+   it, history, details = b, h, d
+   current = nil
+   loaded = nil
+   return it:print_all()
+end
+
 -- Board editing
 
 local function do_edit()
@@ -1165,6 +1201,7 @@ local function do_edit()
    if s then
       push()
       it = board(s)
+      loaded = it:clone()
       return it:print_all()
    else
       return "edit canceled"
@@ -1246,7 +1283,14 @@ other basic rules are: one place for digit in row (r), one place place
 for digit in column (c), and digit is the only one possible in cell
 (d).  These are the workhorse commands.  The command "help basic"
 describes them.  The commands "help advanced" and "help pair" describe
-commands used for difficult puzzles.
+commands used for difficult puzzles, "help subset" describes
+commands for triples and quads, "help fish" describes commands for
+fish, "help wing" describes commands for wings, "help unique"
+describes commands about unique solutions, "help chain"
+describes commands for chains, "help als" describes commands for
+almost locked sets, "help template" describes the command for
+templates, and "help nishio" describes the command for trying a
+digit.
 
 Other useful commands:
 
@@ -1258,6 +1302,14 @@ details -- show detailed cell view.
 
 normal -- show normal cell view.
 
+mem -- show memory use, and a census of boards and cells.
+
+goto <number> -- load a puzzle from the file of puzzles.
+
+next -- load the next puzzle from the file of puzzles.
+
+prev -- load the previous puzzle from the file of puzzles.
+
 Other help topics: board, history, and impatient.  Be
 sure to read the introduction in the help menu.
 ]]
@@ -1265,6 +1317,7 @@ sure to read the introduction in the help menu.
 commands_help = wrap(commands_help)
 
 topics.commands = commands_help
+topics.mem = commands_help
 
 local board_help = [[
 Boards
@@ -1279,11 +1332,38 @@ are ignored: period and the nine non-zero digits.  A period is used to
 denote a blank cell.  Other characters can be used to aid readability.
 Common practice is to list the nine cell characters for each row on
 a separate line of text.
+
+A board saved in a file with the .gsd extension is written as a grid
+of candidates instead, one item per cell giving the digits still
+possible in that cell.  When such a file is loaded, the candidates are
+restored as they were, and a cell with one candidate is taken as
+determined.
+
+A board saved in a file with the .gss extension is written as a
+binary snapshot.  A snapshot keeps everything about the board,
+including its history and whether details are shown, and is restored
+exactly when loaded.
+
+A file can hold many puzzles, one on each line, and a file whose name
+ends in .gz is decompressed as it is read.  Lines that are blank or
+start with # are skipped.  Such a file is opened with its first
+puzzle loaded.  The command "goto <number>" loads any other puzzle,
+and the commands "next" and "prev" load the puzzles that follow and
+precede the current one.  An index of the puzzles in a large file is
+saved next to it, in a file with the .idx extension, so the file
+opens quickly the next time.
+
+A file of puzzles can also be packed into a corpus about a quarter of
+its size with the sudokupack program built with GTK Sudoku.  A corpus
+has the .gsc extension, and opens just as a file of puzzles does.
 ]]
 
 board_help = wrap(board_help)
 
 topics.board = board_help
+topics["goto"] = board_help
+topics.next = board_help
+topics.prev = board_help
 
 local history_help = [[
 History commands
@@ -1315,7 +1395,9 @@ d <digit> <row> <col> -- determine digit.  Digit is the only one
 possible in the given cell.
 
 hint -- print a simple hint.  One of the above rules is
-applicable if a hint is suggested.
+applicable if a hint is suggested.  When none is, the hint may be to
+look for a fish or a chain, as described by "help fish" and "help
+chain".
 ]]
 
 basic_help = wrap(basic_help)
@@ -1379,6 +1461,242 @@ pair_help = wrap(pair_help)
 
 topics.pair = pair_help
 
+local subset_help = [[
+Commands involving triples and quads
+
+ts <digit> <digit> <digit> <row> <col> -- three places for triple in
+square.  Other digits in the three places are eliminated.
+
+tr <digit> <digit> <digit> <row> -- three places for triple in row.
+
+tc <digit> <digit> <digit> <col> -- three places for triple in
+column.
+
+sts <digit> <digit> <digit> <row> <col> -- same triple in square.
+Three cells contain only digits of the triple, so other occurrences
+of the digits in the square are eliminated.
+
+str <digit> <digit> <digit> <row> -- same triple in row.
+
+stc <digit> <digit> <digit> <col> -- same triple in column.
+
+The commands qs, qr, and qc are like ts, tr, and tc, and the commands
+sqs, sqr, and sqc are like sts, str, and stc, but they take four
+digits, and look for four places or four cells.
+
+As with pairs, three or four places are sometimes called a hidden
+triple or quad, and three or four cells that contain only the same
+digits are sometimes called a naked triple or quad.  A cell of a
+naked triple need not contain all three digits.
+]]
+
+subset_help = wrap(subset_help)
+
+topics.subset = subset_help
+
+local fish_help = [[
+Commands involving fish
+
+xr <digit> <row> <row> -- X-Wing in rows.  The digit is possible in
+the two rows only in the same two columns, so other occurrences of the
+digit in those columns are eliminated.
+
+xc <digit> <col> <col> -- X-Wing in columns.  The digit is possible
+in the two columns only in the same two rows, so other occurrences of
+the digit in those rows are eliminated.
+
+The commands swr and swc are like xr and xc, but take three rows or
+columns for a Swordfish, and the commands jr and jc take four for a
+Jellyfish.
+
+fxr <digit> <row> <row> -- finned X-Wing in rows.  As with xr, but
+the digit is also possible in a few other places in the rows, called
+fins, that are all in one square.  Either a fin holds the digit, or
+the X-Wing does, so the digit is eliminated only from the places in
+the columns of the X-Wing that are in the square with the fins.
+
+The commands fxc, fswr, fswc, fjr, and fjc are the finned versions of
+xc, swr, swc, jr, and jc.
+]]
+
+fish_help = wrap(fish_help)
+
+topics.fish = fish_help
+
+local wing_help = [[
+Commands involving wings
+
+xy <row> <col> <row> <col> <row> <col> -- XY-Wing.  The first cell is
+the pivot, and has only two digits possible, say x and y.  It sees the
+other two cells, the pincers, one of which has only x and z possible,
+and the other only y and z.  Whichever digit the pivot holds, one of
+the pincers holds z, so z is eliminated from the cells that see both
+pincers.
+
+xyz <row> <col> <row> <col> <row> <col> -- XYZ-Wing.  As with xy, but
+the pivot has x, y, and z possible, so z is eliminated only from the
+cells that see the pivot and both pincers.
+
+w <digit> <row> <col> <row> <col> -- W-Wing.  The two cells do not see
+each other, and have only the same two digits possible, the given
+digit and one other.  The given digit has just two places in some
+square, row, or column, and each cell sees one of them.  One of the
+cells holds the other digit, so it is eliminated from the cells that
+see both.
+]]
+
+wing_help = wrap(wing_help)
+
+topics.wing = wing_help
+
+local unique_help = [[
+Commands about unique solutions
+
+A well made puzzle has just one solution.  The unique command checks
+that a board has one.  The other rules here eliminate digits that
+would allow a second solution, and so are wrong for a puzzle that has
+more than one.  They are used only when a unique solution is
+assumed, which is so unless the noassume command is given.
+
+assume -- use rules that assume a unique solution.
+
+noassume -- do not use rules that assume a unique solution.
+
+ur <row> <col> <row> <col> -- unique rectangle.  The cells give
+opposite corners of a rectangle whose corners are in two squares.
+When the four corners have the same two digits possible, some corner
+must hold another digit, or the two digits could be swapped.  In type
+1, just one corner has other digits, so the pair is eliminated from
+it.  In the other types, two corners in the same row or column have
+other digits.  In type 2, they share just one other digit, which is
+eliminated from the cells that see both.  In type 3, their other
+digits form a naked subset with other cells in a house they share, so
+those digits are eliminated from the rest of the house.  In type 4,
+one digit of the pair is possible only in those two corners in a
+house they share, so the other digit of the pair is eliminated from
+them.
+
+bug -- BUG+1.  Every undetermined cell has two digits possible, except
+one cell with three.  That cell holds the digit that is possible three
+times in one of its houses.
+
+unique -- check for a unique solution.  Counts the solutions of the
+board with the digits still possible in each cell, stopping at two.
+Reports "unique", "none", or "multiple" with two cells in which the
+two solutions found differ.  The board is not changed.
+]]
+
+unique_help = wrap(unique_help)
+
+topics.unique = unique_help
+
+local chain_help = [[
+Commands involving chains
+
+Two candidates, digits possible in cells, are strongly linked when one
+of them must hold, as when a cell has only two digits possible, or a
+digit has only two places in a square, row, or column.  They are
+weakly linked when both cannot hold, as when they are in the same
+cell, or are the same digit in cells that see each other.
+
+color <digit> -- simple coloring of digit.  The places for the digit
+joined by strong links are given alternating colors, so that the digit
+is in all places of one color.  If two places of one color see each
+other, the digit is eliminated from all places of that color.
+Otherwise, it is eliminated from places that see both colors.
+
+xchain <digit> -- X-Chain of digit.  A chain of places for the digit
+whose links alternate between strong and weak, and whose first and
+last links are strong.  The digit is at one end of the chain or the
+other, so it is eliminated from places that see both ends.
+
+aic -- alternating inference chain.  As with xchain, but the chain may
+use any candidates.  Candidates weakly linked to both ends are
+eliminated.
+
+Unlike the other commands, these search for a chain, and report the
+chain found.  The report reads as a proof: if the first candidate does
+not hold, each step follows from the one before it, ending with a
+candidate that holds.
+]]
+
+chain_help = wrap(chain_help)
+
+topics.chain = chain_help
+
+local als_help = [[
+Commands involving almost locked sets
+
+An almost locked set is some cells in a square, row, or column that
+together have just one more digit possible than there are cells.  A
+single cell with two digits possible is one.  Two sets that do not
+share a cell have a restricted common digit when the digit is possible
+in both, and each place for it in one set sees each place for it in
+the other, so that at most one of the sets holds it.
+
+alsxz -- almost locked sets with a common digit.  Two sets have a
+restricted common digit x.  One of them does not hold x, so it holds
+all its other digits.  Hence each other digit z possible in both sets
+is in one of them, and is eliminated from cells that see every place
+for z in the two sets.
+
+alsxy -- ALS-XY-Wing.  Two sets each have a restricted common digit
+with a third set, x for one and y for the other.  The third set cannot
+lack both x and y, so one of the first two sets holds its other
+digits.  A digit z in both of the first two sets is eliminated from
+cells that see every place for z in them.
+
+These commands search for sets, and report the sets found.  The all
+command tries them last, and gives up on them when the search takes
+too long, but these commands do not.
+]]
+
+als_help = wrap(als_help)
+
+topics.als = als_help
+
+local template_help = [[
+The pattern overlay method
+
+A template of a digit is a set of nine cells, one in each row, column,
+and square, in which the digit could be placed.  There are 46,656 of
+them.  A template agrees with the board when it has each cell in which
+the digit is determined, and the digit is possible in the rest.  The
+digit is in the cells of one template that agrees with the board, so
+it is eliminated from each cell in none of them.
+
+pom <digit> -- pattern overlay method.  Eliminates the digit from the
+cells in no template that agrees with the board.
+
+The all command tries templates after every other rule but Nishio.
+They find whatever fish and chains on a single digit would find, but
+say little about why a digit is eliminated.
+]]
+
+template_help = wrap(template_help)
+
+topics.template = template_help
+
+local nishio_help = [[
+Trying a digit
+
+nishio <row> <col> <digit> -- try a digit.  The digit is placed in
+the cell, and then each cell in which only one digit is possible, and
+each place that is the only one for a digit in a square, row, or
+column, is determined in turn.  If this leads to a cell with no digit
+left, or a digit with no place in a square, row, or column, the digit
+tried is eliminated from the cell.  The board is otherwise left as it
+was.  The forcing chain from the digit tried to the contradiction is
+reported.
+
+The all command tries every digit possible on the board last of all,
+and reports the shortest forcing chain found.
+]]
+
+nishio_help = wrap(nishio_help)
+
+topics.nishio = nishio_help
+
 local impatient_help = [[
 Commands that try many rules.
 
@@ -1392,6 +1710,18 @@ place for digit in column, and digit is the only one possible in cell.
 all -- try all rules.  Stops when one rule makes progress.
 
 solve -- repeatly apply all rules.  Stops when no rule is applicable.
+
+The result of solving a board just as it was loaded is kept in a
+cache, so solving the same puzzle again takes no time.  When a puzzle
+is loaded from a file of puzzles, the status line shows whether it
+was solved before, the number of steps solve took, and the difficulty
+of the hardest rule it used: 1 for simple rules, 2 for rules about a
+row or column in a square, 3 for rules about pairs, 4 for rules about
+triples and quads, 5 for fish, 6 for finned fish, 7 for wings, 8 for
+rules that assume a unique solution, 9 for simple coloring, 10 for
+X-Chains, 11 for other chains, 12 for almost locked sets, 13 for
+templates, and 14 for Nishio.  Only boards solved completely while a
+unique solution is assumed are kept.
 ]]
 
 impatient_help = wrap(impatient_help)
@@ -1411,6 +1741,84 @@ local function do_help(topic)
    show(s);
 end
 
+-- Files of puzzles
+
+local function goto_puzzle(n)
+   local s = puzzle(n)
+   if not s then
+      if current then
+	 return "no puzzle " .. n
+      else
+	 return "no file of puzzles"
+      end
+   end
+   local ok, b = pcall(board, s)
+   if not ok then
+      return b
+   end
+   it = b
+   history = {}
+   current = n
+   loaded = it:clone()
+   it:print_all()
+   local solved, difficulty, steps = lookup_solution(tostring(it))
+   if solved then
+      return string.format("puzzle %d, solved before in %d steps "
+			   .. "at difficulty %d", n, steps, difficulty)
+   end
+   return "puzzle " .. n
+end
+
+local function do_goto(n)
+   if type(n) ~= "number" or n < 1 then
+      return "goto <number> -- load a puzzle from the file of puzzles"
+   end
+   return goto_puzzle(n)
+end
+
+local function do_next()
+   return goto_puzzle((current or 0) + 1)
+end
+
+local function do_prev()
+   return goto_puzzle((current or 2) - 1)
+end
+
+-- Memory use
+
+local function do_mem()
+   local m = mem_stats()
+   local c = census({[Cell] = "Cell", [Board] = "Board"})
+   local lines = {
+      "Memory use",
+      "",
+      string.format("Bytes in use: %d", m.in_use),
+      string.format("High-water mark: %d bytes", m.peak),
+      string.format("Blocks allocated: %d, freed: %d", m.allocs, m.frees),
+      "",
+      "Previous command",
+      "",
+      string.format("High-water mark: %d bytes", m.last_peak),
+      string.format("Blocks allocated: %d, freed: %d",
+		    m.last_allocs, m.last_frees),
+      "",
+      "Objects by metatable",
+      ""
+   }
+   local names = {}
+   for name in pairs(c) do
+      names[1 + #names] = name
+   end
+   table.sort(names)
+   for i,name in ipairs(names) do
+      lines[1 + #lines] = string.format("%s: %d", name, c[name])
+   end
+   lines[1 + #lines] = ""
+   lines[1 + #lines] = string.format("History entries: %d", #history)
+   show(table.concat(lines, "\n"))
+   return string.format("%d bytes in use", m.in_use)
+end
+
 -- Command processing
 
 -- The command table maps a command name to a command.
@@ -1433,6 +1841,14 @@ function eval(name, ...)
 	 return do_help(...)
       elseif name == "index" then
 	 return do_help(name, ...)
+      elseif name == "mem" then
+	 return do_mem(...)
+      elseif name == "goto" then
+	 return do_goto(...)
+      elseif name == "next" then
+	 return do_next(...)
+      elseif name == "prev" then
+	 return do_prev(...)
       else
 	 return "command " .. name .. " unknown"
       end
@@ -1541,9 +1957,7 @@ cmds.d.nargs = 3
 cmds.d.help = "d <digit> <row> <col> -- determine digit"
 topics.d = basic_help
 function cmds.d.op(d, row, col)
-   local r1, r2 = spread(row)
-   local c1, c2 = spread(col)
-   return it:propagate_elimination(r1, c1, r2, c2, d)
+   return it:propagate_elimination((row - 1) * digits + col)
 end
 
 -- Advanced square rules
@@ -1631,7 +2045,416 @@ function cmds.spc.op(d1, d2, col)
    return it:same_pair_in_column(d1, d2, col)
 end
 
--- Rules for triples have not been implemented.
+-- Rules involving triples and quads
+
+cmds.ts = {}
+cmds.ts.nargs = 5
+cmds.ts.help =
+   "ts <digit> <digit> <digit> <row> <col> -- three places for triple in square"
+topics.ts = subset_help
+function cmds.ts.op(d1, d2, d3, row, col)
+   return it:places_for_subset(square_house(row, col), d1, d2, d3)
+end
+
+cmds.tr = {}
+cmds.tr.nargs = 4
+cmds.tr.help =
+   "tr <digit> <digit> <digit> <row> -- three places for triple in row"
+topics.tr = subset_help
+function cmds.tr.op(d1, d2, d3, row)
+   return it:places_for_subset(row_house(row), d1, d2, d3)
+end
+
+cmds.tc = {}
+cmds.tc.nargs = 4
+cmds.tc.help =
+   "tc <digit> <digit> <digit> <col> -- three places for triple in column"
+topics.tc = subset_help
+function cmds.tc.op(d1, d2, d3, col)
+   return it:places_for_subset(column_house(col), d1, d2, d3)
+end
+
+cmds.sts = {}
+cmds.sts.nargs = 5
+cmds.sts.help =
+   "sts <digit> <digit> <digit> <row> <col> -- same triple in square"
+topics.sts = subset_help
+function cmds.sts.op(d1, d2, d3, row, col)
+   return it:same_subset(square_house(row, col), d1, d2, d3)
+end
+
+cmds.str = {}
+cmds.str.nargs = 4
+cmds.str.help =
+   "str <digit> <digit> <digit> <row> -- same triple in row"
+topics.str = subset_help
+function cmds.str.op(d1, d2, d3, row)
+   return it:same_subset(row_house(row), d1, d2, d3)
+end
+
+cmds.stc = {}
+cmds.stc.nargs = 4
+cmds.stc.help =
+   "stc <digit> <digit> <digit> <col> -- same triple in column"
+topics.stc = subset_help
+function cmds.stc.op(d1, d2, d3, col)
+   return it:same_subset(column_house(col), d1, d2, d3)
+end
+
+cmds.qs = {}
+cmds.qs.nargs = 6
+cmds.qs.help =
+   "qs <digit> <digit> <digit> <digit> <row> <col> -- four places for quad in square"
+topics.qs = subset_help
+function cmds.qs.op(d1, d2, d3, d4, row, col)
+   return it:places_for_subset(square_house(row, col), d1, d2, d3, d4)
+end
+
+cmds.qr = {}
+cmds.qr.nargs = 5
+cmds.qr.help =
+   "qr <digit> <digit> <digit> <digit> <row> -- four places for quad in row"
+topics.qr = subset_help
+function cmds.qr.op(d1, d2, d3, d4, row)
+   return it:places_for_subset(row_house(row), d1, d2, d3, d4)
+end
+
+cmds.qc = {}
+cmds.qc.nargs = 5
+cmds.qc.help =
+   "qc <digit> <digit> <digit> <digit> <col> -- four places for quad in column"
+topics.qc = subset_help
+function cmds.qc.op(d1, d2, d3, d4, col)
+   return it:places_for_subset(column_house(col), d1, d2, d3, d4)
+end
+
+cmds.sqs = {}
+cmds.sqs.nargs = 6
+cmds.sqs.help =
+   "sqs <digit> <digit> <digit> <digit> <row> <col> -- same quad in square"
+topics.sqs = subset_help
+function cmds.sqs.op(d1, d2, d3, d4, row, col)
+   return it:same_subset(square_house(row, col), d1, d2, d3, d4)
+end
+
+cmds.sqr = {}
+cmds.sqr.nargs = 5
+cmds.sqr.help =
+   "sqr <digit> <digit> <digit> <digit> <row> -- same quad in row"
+topics.sqr = subset_help
+function cmds.sqr.op(d1, d2, d3, d4, row)
+   return it:same_subset(row_house(row), d1, d2, d3, d4)
+end
+
+cmds.sqc = {}
+cmds.sqc.nargs = 5
+cmds.sqc.help =
+   "sqc <digit> <digit> <digit> <digit> <col> -- same quad in column"
+topics.sqc = subset_help
+function cmds.sqc.op(d1, d2, d3, d4, col)
+   return it:same_subset(column_house(col), d1, d2, d3, d4)
+end
+
+-- Fish
+
+cmds.xr = {}
+cmds.xr.nargs = 3
+cmds.xr.help = "xr <digit> <row> <row> -- X-Wing in rows"
+topics.xr = fish_help
+function cmds.xr.op(d, row1, row2)
+   return it:fish(d, "row", false, row1, row2)
+end
+
+cmds.xc = {}
+cmds.xc.nargs = 3
+cmds.xc.help = "xc <digit> <col> <col> -- X-Wing in columns"
+topics.xc = fish_help
+function cmds.xc.op(d, col1, col2)
+   return it:fish(d, "column", false, col1, col2)
+end
+
+cmds.swr = {}
+cmds.swr.nargs = 4
+cmds.swr.help = "swr <digit> <row> <row> <row> -- Swordfish in rows"
+topics.swr = fish_help
+function cmds.swr.op(d, row1, row2, row3)
+   return it:fish(d, "row", false, row1, row2, row3)
+end
+
+cmds.swc = {}
+cmds.swc.nargs = 4
+cmds.swc.help = "swc <digit> <col> <col> <col> -- Swordfish in columns"
+topics.swc = fish_help
+function cmds.swc.op(d, col1, col2, col3)
+   return it:fish(d, "column", false, col1, col2, col3)
+end
+
+cmds.jr = {}
+cmds.jr.nargs = 5
+cmds.jr.help = "jr <digit> <row> <row> <row> <row> -- Jellyfish in rows"
+topics.jr = fish_help
+function cmds.jr.op(d, row1, row2, row3, row4)
+   return it:fish(d, "row", false, row1, row2, row3, row4)
+end
+
+cmds.jc = {}
+cmds.jc.nargs = 5
+cmds.jc.help =
+   "jc <digit> <col> <col> <col> <col> -- Jellyfish in columns"
+topics.jc = fish_help
+function cmds.jc.op(d, col1, col2, col3, col4)
+   return it:fish(d, "column", false, col1, col2, col3, col4)
+end
+
+cmds.fxr = {}
+cmds.fxr.nargs = 3
+cmds.fxr.help = "fxr <digit> <row> <row> -- finned X-Wing in rows"
+topics.fxr = fish_help
+function cmds.fxr.op(d, row1, row2)
+   return it:fish(d, "row", true, row1, row2)
+end
+
+cmds.fxc = {}
+cmds.fxc.nargs = 3
+cmds.fxc.help = "fxc <digit> <col> <col> -- finned X-Wing in columns"
+topics.fxc = fish_help
+function cmds.fxc.op(d, col1, col2)
+   return it:fish(d, "column", true, col1, col2)
+end
+
+cmds.fswr = {}
+cmds.fswr.nargs = 4
+cmds.fswr.help =
+   "fswr <digit> <row> <row> <row> -- finned Swordfish in rows"
+topics.fswr = fish_help
+function cmds.fswr.op(d, row1, row2, row3)
+   return it:fish(d, "row", true, row1, row2, row3)
+end
+
+cmds.fswc = {}
+cmds.fswc.nargs = 4
+cmds.fswc.help =
+   "fswc <digit> <col> <col> <col> -- finned Swordfish in columns"
+topics.fswc = fish_help
+function cmds.fswc.op(d, col1, col2, col3)
+   return it:fish(d, "column", true, col1, col2, col3)
+end
+
+cmds.fjr = {}
+cmds.fjr.nargs = 5
+cmds.fjr.help =
+   "fjr <digit> <row> <row> <row> <row> -- finned Jellyfish in rows"
+topics.fjr = fish_help
+function cmds.fjr.op(d, row1, row2, row3, row4)
+   return it:fish(d, "row", true, row1, row2, row3, row4)
+end
+
+cmds.fjc = {}
+cmds.fjc.nargs = 5
+cmds.fjc.help =
+   "fjc <digit> <col> <col> <col> <col> -- finned Jellyfish in columns"
+topics.fjc = fish_help
+function cmds.fjc.op(d, col1, col2, col3, col4)
+   return it:fish(d, "column", true, col1, col2, col3, col4)
+end
+
+-- Wings
+
+cmds.xy = {}
+cmds.xy.nargs = 6
+cmds.xy.help =
+   "xy <row> <col> <row> <col> <row> <col> -- XY-Wing with pivot first"
+topics.xy = wing_help
+function cmds.xy.op(row, col, row1, col1, row2, col2)
+   return it:xy_wing(cell_at(row, col), cell_at(row1, col1),
+		     cell_at(row2, col2))
+end
+
+cmds.xyz = {}
+cmds.xyz.nargs = 6
+cmds.xyz.help =
+   "xyz <row> <col> <row> <col> <row> <col> -- XYZ-Wing with pivot first"
+topics.xyz = wing_help
+function cmds.xyz.op(row, col, row1, col1, row2, col2)
+   return it:xyz_wing(cell_at(row, col), cell_at(row1, col1),
+		      cell_at(row2, col2))
+end
+
+cmds.w = {}
+cmds.w.nargs = 5
+cmds.w.help = "w <digit> <row> <col> <row> <col> -- W-Wing linked by digit"
+topics.w = wing_help
+function cmds.w.op(d, row1, col1, row2, col2)
+   return it:w_wing(d, cell_at(row1, col1), cell_at(row2, col2))
+end
+
+-- Uniqueness
+
+cmds.assume = {}
+cmds.assume.nargs = 0
+cmds.assume.help = "assume -- use rules that assume a unique solution"
+topics.assume = unique_help
+function cmds.assume.op()
+   assume = true
+   return false, "unique solution assumed"
+end
+
+cmds.noassume = {}
+cmds.noassume.nargs = 0
+cmds.noassume.help =
+   "noassume -- do not use rules that assume a unique solution"
+topics.noassume = unique_help
+function cmds.noassume.op()
+   assume = false
+   return false, "unique solution not assumed"
+end
+
+cmds.ur = {}
+cmds.ur.nargs = 4
+cmds.ur.help = "ur <row> <col> <row> <col> -- unique rectangle"
+topics.ur = unique_help
+function cmds.ur.op(row1, col1, row2, col2)
+   if not assume then
+      return false, "unique solution not assumed"
+   end
+   local type =
+	 it:unique_rectangle(cell_at(row1, col1), cell_at(row2, col2))
+   if type then
+      return true, "unique rectangle type " .. type
+   end
+   return false
+end
+
+cmds.bug = {}
+cmds.bug.nargs = 0
+cmds.bug.help = "bug -- BUG+1"
+topics.bug = unique_help
+function cmds.bug.op()
+   if not assume then
+      return false, "unique solution not assumed"
+   end
+   local d, i = bug_plus_one(it)
+   if d then
+      return true, bug_name(d, i)
+   end
+   return false
+end
+
+cmds.unique = {}
+cmds.unique.nargs = 0
+cmds.unique.help = "unique -- check for a unique solution"
+topics.unique = unique_help
+function cmds.unique.op()
+   local n, first, second = count_solutions(it, 2)
+   if n == 0 then
+      return false, "none"
+   elseif n == 1 then
+      return false, "unique"
+   end
+   local cells = {}
+   for i=1,digits2 do
+      if first[i] ~= second[i] then
+	 cells[1 + #cells] = cell_name(i) .. " is " .. first[i]
+	    .. " or " .. second[i]
+	 if #cells == 2 then
+	    break
+	 end
+      end
+   end
+   return false, "multiple: " .. table.concat(cells, ", ")
+end
+
+-- Chains
+
+cmds.color = {}
+cmds.color.nargs = 1
+cmds.color.help = "color <digit> -- simple coloring of digit"
+topics.color = chain_help
+function cmds.color.op(d)
+   local color_d, i = find_coloring(it, d)
+   if color_d then
+      return true, coloring_name(color_d, i)
+   end
+   return false
+end
+
+cmds.xchain = {}
+cmds.xchain.nargs = 1
+cmds.xchain.help = "xchain <digit> -- X-Chain of digit"
+topics.xchain = chain_help
+function cmds.xchain.op(d)
+   local found = {find_chain(it, d)}
+   if found[1] then
+      return true, chain_name(unpack(found))
+   end
+   return false
+end
+
+cmds.aic = {}
+cmds.aic.nargs = 0
+cmds.aic.help = "aic -- alternating inference chain"
+topics.aic = chain_help
+function cmds.aic.op()
+   local found = {find_chain(it)}
+   if found[1] then
+      return true, chain_name(unpack(found))
+   end
+   return false
+end
+
+-- Almost locked sets
+
+cmds.alsxz = {}
+cmds.alsxz.nargs = 0
+cmds.alsxz.help = "alsxz -- almost locked sets with a common digit"
+topics.alsxz = als_help
+function cmds.alsxz.op()
+   local sets, x, y, zs = find_als(it, "xz")
+   if sets then
+      return true, als_name(sets, x, y, zs)
+   end
+   return false
+end
+
+cmds.alsxy = {}
+cmds.alsxy.nargs = 0
+cmds.alsxy.help = "alsxy -- ALS-XY-Wing"
+topics.alsxy = als_help
+function cmds.alsxy.op()
+   local sets, x, y, zs = find_als(it, "xy")
+   if sets then
+      return true, als_name(sets, x, y, zs)
+   end
+   return false
+end
+
+-- Templates
+
+cmds.pom = {}
+cmds.pom.nargs = 1
+cmds.pom.help = "pom <digit> -- pattern overlay method"
+topics.pom = template_help
+function cmds.pom.op(d)
+   local cells = {it:pattern_overlay(d)}
+   if #cells > 0 then
+      return true, overlay_name(d, unpack(cells))
+   end
+   return false
+end
+
+-- Nishio
+
+cmds.nishio = {}
+cmds.nishio.nargs = 3
+cmds.nishio.help = "nishio <row> <col> <digit> -- try a digit"
+topics.nishio = nishio_help
+function cmds.nishio.op(row, col, d)
+   local found = {it:nishio(cell_at(row, col), d)}
+   if found[1] then
+      return true, nishio_name(unpack(found))
+   end
+   return false
+end
 
 -- Hints
 
@@ -1674,12 +2497,29 @@ cmds.solve.nargs = 0
 cmds.solve.help = "solve -- repeatly apply all rules"
 topics.solve = impatient_help
 function cmds.solve.op()
+   local clues			-- Set when solving the board as loaded
+   if assume and loaded and it:same(loaded) then
+      clues = tostring(it)
+      local solved = lookup_solution(clues)
+      if solved then
+	 it = setmetatable(solved, Board)
+	 return not it:same(loaded)
+      end
+   end
    local e = false
    local f = false
+   local steps, hardest = 0, 0
    repeat
       f = it:all()
+      if f then
+	 steps = steps + 1
+	 hardest = math.max(hardest, level)
+      end
       e = e or f
    until not f
+   if clues and it:solved() then
+      store_solution(clues, it, hardest, steps)
+   end
    return e
 end
 
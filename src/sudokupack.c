@@ -0,0 +1,268 @@
+/*
+ * Converts files of puzzles, one per line, to and from packed
+ * corpora.
+ *
+ * Copyright (C) 2006 John D. Ramsdell
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <stddef.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "config.h"
+#include "gtksudoku.h"
+#include "board.h"
+#include "corpus.h"
+#include "solver.h"
+
+static void
+print_version(const char *program)
+{
+  fprintf(stderr, "%s %s\n", program, VERSION);
+}
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+	  "Usage: %s [options] file\n"
+	  "Options:\n"
+	  "  -u      -- unpack a corpus into a file of puzzles\n"
+	  "  -c      -- leave out puzzles without a unique solution\n"
+	  "  -o file -- output to file (default is standard output)\n"
+	  "  -v      -- print version information\n"
+	  "  -h      -- print this message\n",
+	  prog);
+}
+
+static void *
+xrealloc(void *ptr, size_t size)
+{
+  ptr = realloc(ptr, size);
+  if (!ptr) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(1);
+  }
+  return ptr;
+}
+
+/* Read all of standard input.  Sets n to the number of bytes read. */
+
+static unsigned char *
+slurp(size_t *n)
+{
+  size_t size = BUFSIZ;
+  unsigned char *buf = xrealloc(NULL, size);
+  *n = 0;
+  for (;;) {
+    *n += fread(buf + *n, 1, size - *n, stdin);
+    if (*n < size)
+      break;
+    size *= 2;
+    buf = xrealloc(buf, size);
+  }
+  if (ferror(stdin)) {
+    perror("read");
+    exit(1);
+  }
+  return buf;
+}
+
+/* Does the puzzle given by the first NCELLS valid cell descriptors
+   in the len characters of line have a unique solution?  If not,
+   says why. */
+
+static int
+unique(const char *input, int lineno, const char *line, size_t len)
+{
+  char clues[NCELLS + 1];
+  int vals[NCELLS], determined[NCELLS];
+  size_t k;
+  int n = 0;
+  for (k = 0; k < len && n < NCELLS; k++)
+    if (isboardchar(line[k]))
+      clues[n++] = line[k];
+  clues[n] = 0;
+  if (n < NCELLS || board_read(clues, vals, determined) < 0)
+    return 1;			/* Left for corpus_pack to report */
+  switch (solver_count(vals, 2, NULL)) {
+  case 0:
+    fprintf(stderr, "%s:%d: no solution\n", input, lineno);
+    return 0;
+  case 1:
+    return 1;
+  default:
+    fprintf(stderr, "%s:%d: multiple solutions\n", input, lineno);
+    return 0;
+  }
+}
+
+/* Pack each line that is not blank or a comment.  When checking, a
+   puzzle without a unique solution is left out. */
+
+static int
+pack(const char *input, int checking)
+{
+  size_t n;
+  char *text = (char *)slurp(&n);
+  size_t size = BUFSIZ, used = 0;
+  unsigned char *data = xrealloc(NULL, size);
+  size_t nblocks = 0;
+  unsigned long *offsets = NULL;
+  int count = 0, lineno = 0;
+
+  size_t at = 0;
+  while (at < n) {
+    const char *line = text + at;
+    const char *end = memchr(line, '\n', n - at);
+    size_t len = end ? (size_t)(end - line) : n - at;
+    at += end ? len + 1 : len;
+    lineno++;
+    if (!len || *line == '\r' || *line == '#')
+      continue;
+    if (checking && !unique(input, lineno, line, len))
+      continue;
+    if (used > CORPUS_MAX_PACKED || count == INT_MAX) {
+      fprintf(stderr, "%s:%d: corpus is too large\n", input, lineno);
+      return 1;
+    }
+    if (count % CORPUS_BLOCK == 0) {
+      offsets = xrealloc(offsets, (nblocks + 1) * sizeof *offsets);
+      offsets[nblocks++] = used;
+    }
+    if (used + CORPUS_PUZZLE_MAX > size) {
+      size *= 2;
+      data = xrealloc(data, size);
+    }
+    size_t m = corpus_pack(data + used, line, len);
+    if (!m) {
+      fprintf(stderr, "%s:%d: not a board\n", input, lineno);
+      return 1;
+    }
+    used += m;
+    count++;
+  }
+
+  size_t header = corpus_header_size(count);
+  size_t i;
+  for (i = 0; i < nblocks; i++)
+    offsets[i] += header;
+  unsigned char *head = xrealloc(NULL, header);
+  corpus_put_header(head, count, offsets);
+  if (fwrite(head, 1, header, stdout) != header
+      || fwrite(data, 1, used, stdout) != used) {
+    perror("write");
+    return 1;
+  }
+  free(head);
+  free(offsets);
+  free(data);
+  free(text);
+  return 0;
+}
+
+/* Write each puzzle on a line of its own. */
+
+static int
+unpack(const char *input)
+{
+  size_t n;
+  unsigned char *buf = slurp(&n);
+  int count;
+  const char *msg = corpus_open(buf, n, &count);
+  if (msg) {
+    fprintf(stderr, "%s: %s\n", input, msg);
+    return 1;
+  }
+  char line[NCELLS + 1];
+  line[NCELLS] = '\n';
+  int k;
+  for (k = 0; k < count; k++) {
+    if (!corpus_get(buf, n, k, line)) {
+      fprintf(stderr, "%s: corpus is truncated\n", input);
+      return 1;
+    }
+    fwrite(line, 1, sizeof line, stdout);
+  }
+  free(buf);
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  extern char *optarg;
+  extern int optind;
+
+  char *input = NULL;
+  char *output = NULL;
+  int unpacking = 0;
+  int checking = 0;
+
+  for (;;) {
+    int c = getopt(argc, argv, "uco:vh");
+    if (c == -1)
+      break;
+    switch (c) {
+    case 'u':
+      unpacking = 1;
+      break;
+    case 'c':
+      checking = 1;
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    case 'v':
+      print_version(argv[0]);
+      return 0;
+    case 'h':
+      usage(argv[0]);
+      return 0;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (argc != optind + 1) {
+    fprintf(stderr, "Bad arg count\n");
+    usage(argv[0]);
+    return 1;
+  }
+
+  input = argv[optind];
+  if (!freopen(input, "rb", stdin)) {
+    perror(input);
+    return 1;
+  }
+
+  if (output && !freopen(output, unpacking ? "w" : "wb", stdout)) {
+    perror(output);
+    return 1;
+  }
+
+  int status = unpacking ? unpack(input) : pack(input, checking);
+  if (!status && (ferror(stdout) || fclose(stdout))) {
+    perror("write");
+    return 1;
+  }
+  return status;
+}